@@ -0,0 +1,257 @@
+#include <string.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
+#include "http_conn.h"
+
+#define HTTP_CONN_MAX 4           // Servidores distintos con conexión propia
+#define HTTP_CONN_MAX_HEADERS 4   // Cabeceras por petición
+#define HTTP_CONN_ORIGIN_LEN 96
+
+static const char *TAG = "HTTP";
+
+struct http_conn {
+    char origin[HTTP_CONN_ORIGIN_LEN];  // esquema://host[:puerto]
+    esp_http_client_handle_t client;
+    SemaphoreHandle_t lock;             // Una petición a la vez por conexión
+
+    // Petición en curso
+    http_event_handle_cb handler;
+    void *user_data;
+    const char *headers[HTTP_CONN_MAX_HEADERS];
+    size_t header_count;
+    int64_t connect_start_us;
+    bool open;                          // Hay un socket abierto con el servidor
+    bool connected;                     // Se abrió una conexión nueva para esta petición
+    uint32_t connect_ms;                // Duración de la conexión abierta, handshake incluido
+};
+
+static struct http_conn conns[HTTP_CONN_MAX];
+static SemaphoreHandle_t conns_lock = NULL;
+static http_conn_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void http_conn_origin(const char *url, char *origin, size_t len) {
+    const char *host = strstr(url, "://");
+    host = host != NULL ? host + 3 : url;
+    size_t host_len = strcspn(host, "/?#");
+    snprintf(origin, len, "%.*s", (int)(host - url + host_len), url);
+}
+
+static esp_err_t http_conn_event(esp_http_client_event_t *evt) {
+    http_conn_t *conn = (http_conn_t *)evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED) {
+        uint32_t ms = (uint32_t)((esp_timer_get_time() - conn->connect_start_us) / 1000);
+        conn->open = true;
+        conn->connected = true;
+        conn->connect_ms = ms;
+        portENTER_CRITICAL(&stats_lock);
+        stats.connects++;
+        stats.last_connect_ms = ms;
+        stats.total_connect_ms += ms;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGI(TAG, "Conexión nueva con %s en %lu ms", conn->origin, (unsigned long)ms);
+    } else if (evt->event_id == HTTP_EVENT_DISCONNECTED) {
+        // También se emite en cada esp_http_client_close
+        conn->open = false;
+    }
+
+    if (conn->handler == NULL) {
+        return ESP_OK;
+    }
+    esp_http_client_event_t forwarded = *evt;
+    forwarded.user_data = conn->user_data;
+    return conn->handler(&forwarded);
+}
+
+static esp_err_t http_conn_create(http_conn_t *conn, const char *url, const char *origin) {
+    esp_http_client_config_t config = {
+        .url = url,
+        .event_handler = http_conn_event,
+        .user_data = conn,
+        .timeout_ms = CONFIG_HTTP_CONN_TIMEOUT_MS,
+        .keep_alive_enable = true,
+#if !CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,
+#endif
+    };
+
+    conn->lock = xSemaphoreCreateMutex();
+    if (conn->lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    conn->client = esp_http_client_init(&config);
+    if (conn->client == NULL) {
+        vSemaphoreDelete(conn->lock);
+        conn->lock = NULL;
+        return ESP_FAIL;
+    }
+    strlcpy(conn->origin, origin, sizeof(conn->origin));
+    return ESP_OK;
+}
+
+static void http_conn_count_request(http_conn_t *conn) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.requests++;
+    if (!conn->connected) {
+        stats.reused++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+esp_err_t http_conn_init(void) {
+    if (conns_lock == NULL) {
+        conns_lock = xSemaphoreCreateMutex();
+    }
+    return conns_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+http_conn_t *http_conn_acquire(const char *url, esp_http_client_method_t method,
+                               http_event_handle_cb handler, void *user_data) {
+    char origin[HTTP_CONN_ORIGIN_LEN];
+    http_conn_origin(url, origin, sizeof(origin));
+
+    if (conns_lock == NULL) {
+        ESP_LOGE(TAG, "Error: http_conn_init no se ha llamado.");
+        return NULL;
+    }
+
+    xSemaphoreTake(conns_lock, portMAX_DELAY);
+    http_conn_t *conn = NULL;
+    http_conn_t *unused = NULL;
+    for (int i = 0; i < HTTP_CONN_MAX && conn == NULL; i++) {
+        if (conns[i].client == NULL) {
+            unused = unused != NULL ? unused : &conns[i];
+        } else if (strcmp(conns[i].origin, origin) == 0) {
+            conn = &conns[i];
+        }
+    }
+    if (conn == NULL && unused != NULL && http_conn_create(unused, url, origin) == ESP_OK) {
+        conn = unused;
+    }
+    xSemaphoreGive(conns_lock);
+
+    if (conn == NULL) {
+        ESP_LOGE(TAG, "Error: no se pudo crear la conexión con %s.", origin);
+        return NULL;
+    }
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    // Mismo servidor: esp_http_client_set_url mantiene la conexión abierta
+    esp_http_client_set_url(conn->client, url);
+    esp_http_client_set_method(conn->client, method);
+    conn->handler = handler;
+    conn->user_data = user_data;
+    return conn;
+}
+
+esp_http_client_handle_t http_conn_client(http_conn_t *conn) {
+    return conn->client;
+}
+
+esp_err_t http_conn_set_header(http_conn_t *conn, const char *key, const char *value) {
+    if (conn->header_count == HTTP_CONN_MAX_HEADERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_http_client_set_header(conn->client, key, value);
+    if (err == ESP_OK) {
+        conn->headers[conn->header_count++] = key;
+    }
+    return err;
+}
+
+// Solo merece la pena repetir una petición que falló en una conexión que ya
+// estaba abierta (el servidor pudo cerrarla). Si falló al conectar, repetir
+// solo duplicaría la espera.
+static bool http_conn_should_retry(http_conn_t *conn, bool was_open, int attempt) {
+    return attempt == 0 && was_open && !conn->connected;
+}
+
+esp_err_t http_conn_open(http_conn_t *conn, int *content_length) {
+    for (int attempt = 0;; attempt++) {
+        bool was_open = conn->open;
+        conn->connected = false;
+        conn->connect_start_us = esp_timer_get_time();
+
+        esp_err_t err = esp_http_client_open(conn->client, 0);
+        if (err == ESP_OK) {
+            *content_length = esp_http_client_fetch_headers(conn->client);
+            if (*content_length < 0) {
+                err = ESP_FAIL;
+            }
+        }
+        if (err == ESP_OK) {
+            http_conn_count_request(conn);
+            return ESP_OK;
+        }
+
+        esp_http_client_close(conn->client);
+        if (!http_conn_should_retry(conn, was_open, attempt)) {
+            return err;
+        }
+        ESP_LOGI(TAG, "La conexión con %s estaba cerrada, reconectando...", conn->origin);
+    }
+}
+
+esp_err_t http_conn_perform(http_conn_t *conn) {
+    for (int attempt = 0;; attempt++) {
+        bool was_open = conn->open;
+        conn->connected = false;
+        conn->connect_start_us = esp_timer_get_time();
+
+        esp_err_t err = esp_http_client_perform(conn->client);
+        if (err == ESP_OK) {
+            http_conn_count_request(conn);
+            return ESP_OK;
+        }
+
+        esp_http_client_close(conn->client);
+        if (!http_conn_should_retry(conn, was_open, attempt)) {
+            return err;
+        }
+        ESP_LOGI(TAG, "La conexión con %s estaba cerrada, reconectando...", conn->origin);
+    }
+}
+
+uint32_t http_conn_connect_ms(http_conn_t *conn) {
+    return conn->connect_ms;
+}
+
+bool http_conn_reused(http_conn_t *conn) {
+    return !conn->connected;
+}
+
+void http_conn_release(http_conn_t *conn, bool reusable) {
+    // 204 y 304 no tienen cuerpo que descartar
+    int status = esp_http_client_get_status_code(conn->client);
+    if (reusable && status != 204 && status != 304 &&
+        esp_http_client_flush_response(conn->client, NULL) != ESP_OK) {
+        reusable = false;
+    }
+    if (!reusable) {
+        esp_http_client_close(conn->client);
+    }
+
+    for (size_t i = 0; i < conn->header_count; i++) {
+        esp_http_client_delete_header(conn->client, conn->headers[i]);
+    }
+    conn->header_count = 0;
+    esp_http_client_set_post_field(conn->client, NULL, 0);
+    conn->handler = NULL;
+    conn->user_data = NULL;
+    xSemaphoreGive(conn->lock);
+}
+
+void http_conn_get_stats(http_conn_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
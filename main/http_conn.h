@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+// Conexiones HTTP(S) compartidas: un cliente por servidor (esquema, host y
+// puerto) que se mantiene abierto entre peticiones. Las reconexiones TLS
+// reutilizan la sesión anterior (session tickets) y los certificados se
+// validan con el paquete de CA de ESP-IDF (x509_crt_bundle).
+
+typedef struct http_conn http_conn_t;
+
+// Estadísticas acumuladas de todas las conexiones
+typedef struct {
+    uint32_t requests;          // Peticiones realizadas
+    uint32_t connects;          // Conexiones nuevas (DNS + TCP + TLS)
+    uint32_t reused;            // Peticiones enviadas por una conexión ya abierta
+    uint32_t last_connect_ms;   // Duración de la última conexión nueva, handshake incluido
+    uint32_t total_connect_ms;  // Suma de todas las conexiones nuevas
+} http_conn_stats_t;
+
+// Debe llamarse una vez antes que cualquier otra función de este módulo
+esp_err_t http_conn_init(void);
+
+// Reserva la conexión del servidor de `url` para una petición y la apunta a
+// `url`. Bloquea si otra tarea la está usando. `handler` recibe los eventos
+// de esta petición con `user_data`; puede ser NULL.
+http_conn_t *http_conn_acquire(const char *url, esp_http_client_method_t method,
+                               http_event_handle_cb handler, void *user_data);
+
+esp_http_client_handle_t http_conn_client(http_conn_t *conn);
+
+// Cabecera solo para esta petición: se borra en http_conn_release
+esp_err_t http_conn_set_header(http_conn_t *conn, const char *key, const char *value);
+
+// Envía la petición y lee las cabeceras de la respuesta. Si la conexión
+// reutilizada resulta estar cerrada por el servidor, reconecta una vez.
+esp_err_t http_conn_open(http_conn_t *conn, int *content_length);
+
+// Como esp_http_client_perform, con el mismo reintento que http_conn_open
+esp_err_t http_conn_perform(http_conn_t *conn);
+
+// Duración (DNS + TCP + TLS) de la conexión que usó la última petición,
+// aunque se abriera para una petición anterior
+uint32_t http_conn_connect_ms(http_conn_t *conn);
+
+// Indica si la última petición se envió por una conexión ya abierta
+bool http_conn_reused(http_conn_t *conn);
+
+// Libera la conexión. Con `reusable` se descarta el resto de la respuesta y
+// la conexión queda abierta para la siguiente petición; si no, se cierra.
+void http_conn_release(http_conn_t *conn, bool reusable);
+
+void http_conn_get_stats(http_conn_stats_t *stats);
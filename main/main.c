@@ -8,19 +8,41 @@
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_pm.h"
+#if CONFIG_OTA_BENCH_ENABLE
+#include "esp_eth.h"
+#endif
 #include "nvs_flash.h"
 #include "esp_http_client.h"
-#include "esp_ota_ops.h" // Incluir para las operaciones OTA
+#include "http_conn.h"
+#include "ota_worker.h"
+#include "power.h"
+#include "telemetry.h"
 #include "cJSON.h" // Asegúrate de tener cJSON instalado
 
 #define WIFI_SSID "MiFibra-D96B" // Cambia esto por el SSID de tu red Wi-Fi
 #define WIFI_PASSWORD "PCTXV2vr"   // Cambia esto por la contraseña de tu red Wi-Fi
 #define THINGSBOARD_URL "http://demo.thingsboard.io/api/v1/OhLePMiP1VhGU3QsZWNg/telemetry"
-#define CHECK_UPDATE_INTERVAL pdMS_TO_TICKS(60000) // Intervalo de verificación de actualización (1 minuto)
+#if CONFIG_OTA_BENCH_ENABLE
+// Banco de pruebas en QEMU: servidor local de tools/ota_bench.py
+#define CHECK_UPDATE_INTERVAL_MS CONFIG_OTA_BENCH_CHECK_INTERVAL_MS
+#define OTA_URL CONFIG_OTA_BENCH_FIRMWARE_URL
+#define OTA_MANIFEST_URL CONFIG_OTA_BENCH_MANIFEST_URL
+#else
+#define CHECK_UPDATE_INTERVAL_MS 60000 // Intervalo de verificación de actualización (1 minuto)
 #define OTA_URL "https://raw.githubusercontent.com/Hanane-EB/ota/master/build/app-template.bin" // Cambia esto a la URL de tu firmware
+#define OTA_MANIFEST_URL "https://raw.githubusercontent.com/Hanane-EB/ota/master/build/app-template.json" // Manifiesto generado junto al firmware
+#endif
 
-// Control de conexión
-static bool is_connected = false;
+// Reconexión con backoff: tras reiniciarse el punto de acceso no reconectan
+// todos los equipos a la vez
+static TimerHandle_t reconnect_timer = NULL;
+static unsigned reconnect_attempts = 0;
+
+#if !CONFIG_OTA_BENCH_ENABLE
+static void reconnect_wifi(TimerHandle_t xTimer) {
+    esp_wifi_connect();
+}
+#endif
 
 // Función para manejar eventos de Wi-Fi
 static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
@@ -30,107 +52,34 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
                 esp_wifi_connect();
                 break;
 
-            case WIFI_EVENT_STA_DISCONNECTED:
-                is_connected = false;
-                esp_wifi_connect();
-                ESP_LOGI("WiFi", "Intentando reconectar...");
+            case WIFI_EVENT_STA_DISCONNECTED: {
+                power_set_connected(false);
+                uint32_t delay_ms = power_backoff_ms(CONFIG_WIFI_RECONNECT_MIN_MS, CONFIG_WIFI_RECONNECT_MAX_MS,
+                                                     reconnect_attempts);
+                if (reconnect_attempts < 16) {
+                    reconnect_attempts++;
+                }
+                ESP_LOGI("WiFi", "Intentando reconectar en %lu ms...", (unsigned long)delay_ms);
+                // xTimerChangePeriod también arranca el temporizador
+                xTimerChangePeriod(reconnect_timer, pdMS_TO_TICKS(delay_ms), 0);
                 break;
+            }
 
             default:
                 break;
         }
-    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+    } else if (event_base == IP_EVENT && (event_id == IP_EVENT_STA_GOT_IP || event_id == IP_EVENT_ETH_GOT_IP)) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI("WiFi", "IP obtenido: " IPSTR, IP2STR(&event->ip_info.ip));
-        is_connected = true;
-    }
-}
-
-// Función para realizar la actualización OTA
-void perform_ota_update(const char *url) {
-    ESP_LOGI("OTA", "Iniciando la actualización desde: %s", url);
-    
-    esp_http_client_config_t config = {
-        .url = url,
-        .cert_pem = NULL,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    // Realizar la actualización OTA
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        ESP_LOGI("OTA", "Descargando el firmware...");
-
-        // Aquí debes asegurarte de que la respuesta sea correcta
-        int content_length = esp_http_client_get_content_length(client);
-        if (content_length <= 0) {
-            ESP_LOGE("OTA", "Error: Tamaño del contenido no válido.");
-            esp_http_client_cleanup(client);
-            return;
-        }
-
-        // Almacenar el firmware descargado
-        esp_ota_handle_t update_handle = 0;
-        const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-        if (update_partition == NULL) {
-            ESP_LOGE("OTA", "Error: No hay partición para actualizaciones.");
-            esp_http_client_cleanup(client);
-            return;
-        }
-
-        ESP_ERROR_CHECK(esp_ota_begin(update_partition, content_length, &update_handle));
-
-        // Descarga el firmware en bloques
-        char *buffer = malloc(4096); // Buffer de 4KB
-        if (buffer == NULL) {
-            ESP_LOGE("OTA", "Error: No se pudo asignar memoria para el buffer.");
-            esp_http_client_cleanup(client);
-            return;
-        }
+        reconnect_attempts = 0;
+        power_set_connected(true);
 
-        int data_read = 0;
-        while ((data_read = esp_http_client_read(client, buffer, sizeof(buffer))) > 0) {
-            ESP_LOGI("OTA", "Escribiendo %d bytes a la partición %s", data_read, update_partition->label);
-            esp_err_t write_err = esp_ota_write(update_handle, (const void *)buffer, data_read);
-            if (write_err != ESP_OK) {
-                ESP_LOGE("OTA", "Error al escribir en la partición OTA: %s", esp_err_to_name(write_err));
-                free(buffer);
-                esp_http_client_cleanup(client);
-                return;
-            }
-        }
-
-        // Finalizar la escritura
-        esp_err_t end_err = esp_ota_end(update_handle);
-        if (end_err != ESP_OK) {
-            ESP_LOGE("OTA", "Error finalizando la actualización OTA: %s", esp_err_to_name(end_err));
-        } else {
-            ESP_LOGI("OTA", "Actualización OTA completada con éxito. Reiniciando...");
-
-            // Reiniciar el dispositivo
-            esp_restart();
-        }
-
-        free(buffer);
-    } else {
-        ESP_LOGE("OTA", "Error en la actualización: %s", esp_err_to_name(err));
-    }
-
-    esp_http_client_cleanup(client);
-}
-
-// Función para verificar si hay actualizaciones
-void check_for_updates(TimerHandle_t xTimer) {
-    if (!is_connected) {
-        ESP_LOGI("WiFi", "No hay conexión a la red, no se puede verificar actualizaciones.");
-        return;
+        // Verificar al reconectar para continuar cuanto antes una descarga interrumpida
+        ota_worker_trigger();
     }
-
-    ESP_LOGI("OTA", "Verificando actualizaciones de firmware...");
-    perform_ota_update(OTA_URL);
 }
 
+#if !CONFIG_OTA_BENCH_ENABLE
 // Inicializa Wi-Fi
 static void wifi_init(void) {
     ESP_ERROR_CHECK(esp_netif_init());
@@ -138,6 +87,9 @@ static void wifi_init(void) {
     esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
     assert(sta_netif);
 
+    reconnect_timer = xTimerCreate("WifiReconnect", 1, pdFALSE, NULL, reconnect_wifi);
+    assert(reconnect_timer);
+
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
@@ -157,6 +109,30 @@ static void wifi_init(void) {
     ESP_ERROR_CHECK(esp_wifi_start());
     esp_wifi_connect();
 }
+#else
+// Inicializa la Ethernet OpenCores que emula QEMU (-nic user,model=open_eth)
+static void eth_init(void) {
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_config_t netif_config = ESP_NETIF_DEFAULT_ETH();
+    esp_netif_t *eth_netif = esp_netif_new(&netif_config);
+    assert(eth_netif);
+
+    eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
+    eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
+    phy_config.autonego_timeout_ms = 100;
+    esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_config);
+    esp_eth_phy_t *phy = esp_eth_phy_new_dp83848(&phy_config);
+    esp_eth_config_t eth_config = ETH_DEFAULT_CONFIG(mac, phy);
+    esp_eth_handle_t eth_handle = NULL;
+    ESP_ERROR_CHECK(esp_eth_driver_install(&eth_config, &eth_handle));
+    ESP_ERROR_CHECK(esp_netif_attach(eth_netif, esp_eth_new_netif_glue(eth_handle)));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_ETH_GOT_IP, &event_handler, NULL, NULL));
+    ESP_LOGI("Bench", "Banco de pruebas: Ethernet de QEMU, manifiesto en %s", OTA_MANIFEST_URL);
+    ESP_ERROR_CHECK(esp_eth_start(eth_handle));
+}
+#endif
 
 // Función principal
 void app_main(void) {
@@ -168,21 +144,26 @@ void app_main(void) {
     }
     ESP_ERROR_CHECK(ret);
 
+    // Conexiones HTTP(S) compartidas por OTA y telemetría
+    ESP_ERROR_CHECK(http_conn_init());
+
+    // Escalado de frecuencia y light sleep; antes de iniciar el Wi-Fi
+    ESP_ERROR_CHECK(power_init());
+
+    // Tarea dedicada a las actualizaciones OTA, que también las programa
+    ESP_ERROR_CHECK(ota_worker_start(OTA_MANIFEST_URL, OTA_URL, CHECK_UPDATE_INTERVAL_MS));
+
+#if CONFIG_OTA_BENCH_ENABLE
+    eth_init();
+#else
     // Inicializar Wi-Fi
     wifi_init();
+#endif
 
-    // Crear un temporizador para verificar actualizaciones periódicamente
-    TimerHandle_t update_check_timer = xTimerCreate(
-        "UpdateCheckTimer",
-        CHECK_UPDATE_INTERVAL,
-        pdTRUE, // Timer auto-reload
-        (void *)0,
-        check_for_updates
-    );
-
-    if (update_check_timer != NULL) {
-        xTimerStart(update_check_timer, 0);
-    } else {
-        ESP_LOGE("OTA", "Error creando el temporizador de verificación de actualizaciones");
+#if CONFIG_TELEMETRY_ENABLE
+    // Envío periódico de telemetría en lotes
+    if (telemetry_start(THINGSBOARD_URL) != ESP_OK) {
+        ESP_LOGE("Telemetry", "Error iniciando la telemetría");
     }
+#endif
 }
@@ -0,0 +1,258 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_app_desc.h"
+#include "esp_ota_ops.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include "http_conn.h"
+#include "ota_check.h"
+
+#define OTA_NVS_ETAG_KEY "etag"
+#define OTA_NVS_ETAG_ELF_KEY "etag_elf"  // elf_sha256 de la aplicación que guardó el ETag
+#define OTA_ETAG_MAX_LEN 128
+#define OTA_MANIFEST_MAX_LEN CONFIG_OTA_MANIFEST_MAX_LEN
+
+static const char *TAG = "OTA";
+
+// Datos recogidos de las cabeceras de la respuesta
+typedef struct {
+    char etag[OTA_ETAG_MAX_LEN];
+} ota_check_ctx_t;
+
+static esp_err_t ota_check_http_event(esp_http_client_event_t *evt) {
+    ota_check_ctx_t *ctx = (ota_check_ctx_t *)evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "ETag") == 0) {
+        strlcpy(ctx->etag, evt->header_value, sizeof(ctx->etag));
+    }
+    return ESP_OK;
+}
+
+// El ETag solo vale para la aplicación que lo guardó: tras instalar otra
+// versión (por USB, por ejemplo) hay que volver a comparar el manifiesto
+static void ota_etag_load(char *etag, size_t len, const uint8_t *elf_sha256) {
+    nvs_handle_t nvs;
+    uint8_t stored_elf[32];
+    size_t elf_len = sizeof(stored_elf);
+    etag[0] = '\0';
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, OTA_NVS_ETAG_ELF_KEY, stored_elf, &elf_len) != ESP_OK ||
+        elf_len != sizeof(stored_elf) || memcmp(stored_elf, elf_sha256, sizeof(stored_elf)) != 0 ||
+        nvs_get_str(nvs, OTA_NVS_ETAG_KEY, etag, &len) != ESP_OK) {
+        etag[0] = '\0';
+    }
+    nvs_close(nvs);
+}
+
+static void ota_etag_save(const char *etag, const uint8_t *elf_sha256) {
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (etag[0] != '\0') {
+        nvs_set_str(nvs, OTA_NVS_ETAG_KEY, etag);
+        nvs_set_blob(nvs, OTA_NVS_ETAG_ELF_KEY, elf_sha256, 32);
+    } else {
+        nvs_erase_key(nvs, OTA_NVS_ETAG_KEY);
+        nvs_erase_key(nvs, OTA_NVS_ETAG_ELF_KEY);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static bool ota_parse_hex(const char *hex, uint8_t *out, size_t len) {
+    if (hex == NULL || strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        char *end;
+        out[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Las URL del manifiesto pueden ser relativas al propio manifiesto
+static void ota_resolve_url(const char *manifest_url, const char *url, char *out, size_t len) {
+    const char *slash = strrchr(manifest_url, '/');
+    if (strstr(url, "://") != NULL || slash == NULL) {
+        strlcpy(out, url, len);
+        return;
+    }
+    snprintf(out, len, "%.*s%s", (int)(slash + 1 - manifest_url), manifest_url, url);
+}
+
+#if CONFIG_OTA_DELTA_ENABLE
+// Busca en "patches" el parche cuya base es la compilación en ejecución
+static void ota_parse_patch(const cJSON *root, const char *manifest_url, ota_manifest_t *manifest,
+                            const uint8_t *running_elf_sha256) {
+    const cJSON *patch;
+    cJSON_ArrayForEach(patch, cJSON_GetObjectItem(root, "patches")) {
+        uint8_t base_elf_sha256[32];
+        const cJSON *url = cJSON_GetObjectItem(patch, "url");
+        const cJSON *size = cJSON_GetObjectItem(patch, "size");
+        if (!cJSON_IsString(url) || !cJSON_IsNumber(size) ||
+            !ota_parse_hex(cJSON_GetStringValue(cJSON_GetObjectItem(patch, "base_elf_sha256")),
+                           base_elf_sha256, sizeof(base_elf_sha256))) {
+            continue;
+        }
+        if (memcmp(base_elf_sha256, running_elf_sha256, sizeof(base_elf_sha256)) == 0) {
+            ota_resolve_url(manifest_url, url->valuestring, manifest->patch_url, sizeof(manifest->patch_url));
+            manifest->patch_size = size->valueint;
+            return;
+        }
+    }
+}
+#endif
+
+#if CONFIG_OTA_COMPRESSED_ENABLE
+static void ota_parse_compressed(const cJSON *root, const char *manifest_url, ota_manifest_t *manifest) {
+    const cJSON *compressed = cJSON_GetObjectItem(root, "compressed");
+    const cJSON *url = cJSON_GetObjectItem(compressed, "url");
+    const cJSON *size = cJSON_GetObjectItem(compressed, "size");
+    if (cJSON_IsString(url) && cJSON_IsNumber(size)) {
+        ota_resolve_url(manifest_url, url->valuestring, manifest->compressed_url, sizeof(manifest->compressed_url));
+        manifest->compressed_size = size->valueint;
+    }
+}
+#endif
+
+static esp_err_t ota_parse_manifest(const char *json, const char *manifest_url, ota_manifest_t *manifest,
+                                    const uint8_t *running_elf_sha256) {
+    cJSON *root = cJSON_Parse(json);
+    if (root == NULL) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    esp_err_t err = ESP_OK;
+    const cJSON *version = cJSON_GetObjectItem(root, "version");
+    const cJSON *size = cJSON_GetObjectItem(root, "size");
+    const cJSON *url = cJSON_GetObjectItem(root, "url");
+
+    memset(manifest, 0, sizeof(*manifest));
+    if (!cJSON_IsString(version) || !cJSON_IsNumber(size) ||
+        !ota_parse_hex(cJSON_GetStringValue(cJSON_GetObjectItem(root, "elf_sha256")),
+                       manifest->elf_sha256, sizeof(manifest->elf_sha256)) ||
+        !ota_parse_hex(cJSON_GetStringValue(cJSON_GetObjectItem(root, "sha256")),
+                       manifest->sha256, sizeof(manifest->sha256))) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    } else {
+        strlcpy(manifest->version, version->valuestring, sizeof(manifest->version));
+        manifest->size = size->valueint;
+        if (cJSON_IsString(url)) {
+            ota_resolve_url(manifest_url, url->valuestring, manifest->url, sizeof(manifest->url));
+        }
+#if CONFIG_OTA_DELTA_ENABLE
+        ota_parse_patch(root, manifest_url, manifest, running_elf_sha256);
+#endif
+#if CONFIG_OTA_COMPRESSED_ENABLE
+        ota_parse_compressed(root, manifest_url, manifest);
+#endif
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+// Función para verificar si hay actualizaciones sin descargar la imagen
+esp_err_t ota_check_for_update(const char *manifest_url, ota_manifest_t *manifest,
+                               bool *update_available) {
+    ota_check_ctx_t ctx = { 0 };
+    char stored_etag[OTA_ETAG_MAX_LEN];
+    *update_available = false;
+
+    http_conn_t *conn = http_conn_acquire(manifest_url, HTTP_METHOD_GET, ota_check_http_event, &ctx);
+    if (conn == NULL) {
+        return ESP_FAIL;
+    }
+    esp_http_client_handle_t client = http_conn_client(conn);
+    const esp_app_desc_t *running = esp_app_get_description();
+
+    ota_etag_load(stored_etag, sizeof(stored_etag), running->app_elf_sha256);
+    if (stored_etag[0] != '\0') {
+        http_conn_set_header(conn, "If-None-Match", stored_etag);
+    }
+
+    char *body = NULL;
+    int content_length;
+    esp_err_t err = http_conn_open(conn, &content_length);
+    bool opened = err == ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error descargando el manifiesto: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+
+    int status = esp_http_client_get_status_code(client);
+    if (status == 304) {
+        ESP_LOGI(TAG, "El manifiesto no ha cambiado.");
+        goto cleanup;
+    }
+    if (status != 200) {
+        ESP_LOGE(TAG, "Error: respuesta HTTP %d al pedir el manifiesto.", status);
+        err = ESP_FAIL;
+        goto cleanup;
+    }
+
+    if (content_length >= OTA_MANIFEST_MAX_LEN) {
+        ESP_LOGE(TAG, "Error: el manifiesto ocupa %d bytes, el máximo es %d (CONFIG_OTA_MANIFEST_MAX_LEN).",
+                 content_length, OTA_MANIFEST_MAX_LEN - 1);
+        err = ESP_ERR_INVALID_SIZE;
+        goto cleanup;
+    }
+    // Sin Content-Length (chunked) se reserva el máximo
+    int body_size = content_length > 0 ? content_length + 1 : OTA_MANIFEST_MAX_LEN;
+    body = malloc(body_size);
+    if (body == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    int len = 0;
+    int read;
+    while (len < body_size - 1 && (read = esp_http_client_read(client, body + len, body_size - 1 - len)) > 0) {
+        len += read;
+    }
+    body[len] = '\0';
+    if (!esp_http_client_is_complete_data_received(client)) {
+        if (len == OTA_MANIFEST_MAX_LEN - 1) {
+            ESP_LOGE(TAG, "Error: el manifiesto supera el máximo de %d bytes (CONFIG_OTA_MANIFEST_MAX_LEN).",
+                     OTA_MANIFEST_MAX_LEN - 1);
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            ESP_LOGE(TAG, "Error: el manifiesto llegó incompleto.");
+            err = ESP_FAIL;
+        }
+        goto cleanup;
+    }
+
+    err = ota_parse_manifest(body, manifest_url, manifest, running->app_elf_sha256);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error: manifiesto no válido.");
+        goto cleanup;
+    }
+
+    if (memcmp(manifest->elf_sha256, running->app_elf_sha256, sizeof(manifest->elf_sha256)) == 0) {
+        ESP_LOGI(TAG, "El firmware está actualizado (versión %s).", running->version);
+        // Solo se recuerda el ETag cuando no queda nada por instalar
+        ota_etag_save(ctx.etag, running->app_elf_sha256);
+    } else {
+        ESP_LOGI(TAG, "Nueva versión disponible: %s (actual %s, %d bytes)",
+                 manifest->version, running->version, manifest->size);
+        *update_available = true;
+    }
+
+cleanup:
+    free(body);
+    // La conexión queda abierta para la descarga de la imagen
+    http_conn_release(conn, opened);
+    return err;
+}
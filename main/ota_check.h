@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define OTA_NVS_NAMESPACE "ota"
+
+// Contenido del manifiesto generado por tools/ota_manifest.py
+typedef struct {
+    char version[32];
+    char url[256];           // Vacío si el manifiesto no indica URL de descarga
+    uint8_t elf_sha256[32];  // Identifica la compilación (esp_app_desc_t)
+    uint8_t sha256[32];      // SHA-256 del fichero .bin completo
+    int size;
+    char patch_url[256];     // Parche delta desde la aplicación en ejecución; vacío si no hay
+    int patch_size;
+    char compressed_url[256]; // Imagen comprimida (tools/ota_pack.py); vacío si no hay
+    int compressed_size;
+} ota_manifest_t;
+
+// Descarga el manifiesto de `manifest_url` con una petición condicional
+// (If-None-Match con el ETag guardado en NVS) y lo compara con la aplicación
+// en ejecución. `update_available` solo es true si la compilación es distinta.
+// Si el manifiesto incluye un parche cuya base es la aplicación en ejecución,
+// se rellenan `patch_url` y `patch_size`; si incluye una imagen comprimida,
+// `compressed_url` y `compressed_size`. Las URL relativas se resuelven
+// respecto a `manifest_url`.
+esp_err_t ota_check_for_update(const char *manifest_url, ota_manifest_t *manifest,
+                               bool *update_available);
@@ -0,0 +1,250 @@
+#include <string.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "ota_update.h"
+#include "ota_delta.h"
+
+#define OTA_DELTA_MAGIC "OTAD"
+#define OTA_DELTA_HEADER_LEN 76 // magic + base_size + target_size + 2 x SHA-256
+#define OTA_DELTA_OP_COPY 0x01
+#define OTA_DELTA_OP_INSERT 0x02
+#define OTA_DELTA_OUT_SIZE CONFIG_OTA_BLOCK_SIZE
+
+static const char *TAG = "OTA";
+
+typedef enum {
+    DELTA_HEADER,  // Acumulando la cabecera
+    DELTA_OP,      // Esperando el código de la siguiente operación
+    DELTA_ARGS,    // Acumulando los argumentos de la operación
+    DELTA_INSERT,  // Copiando datos nuevos del parche
+} ota_delta_state_t;
+
+struct ota_delta {
+    const esp_partition_t *base;
+    const ota_manifest_t *manifest;
+    ota_output_fn output;
+    void *output_ctx;
+
+    ota_delta_state_t state;
+    uint8_t op;
+    uint8_t acc[OTA_DELTA_HEADER_LEN]; // Cabecera o argumentos partidos entre bloques
+    size_t acc_len;
+    size_t acc_need;
+    uint32_t insert_left;
+
+    uint32_t base_size;
+    uint32_t target_size;
+    size_t produced;  // Bytes de la imagen nueva generados hasta ahora
+
+    char *out;        // Los datos se agrupan aquí antes de escribirlos en flash
+    size_t out_len;
+};
+
+static uint32_t ota_delta_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static esp_err_t ota_delta_flush(ota_delta_t *delta) {
+    if (delta->out_len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = delta->output(delta->output_ctx, delta->out, delta->out_len);
+    delta->out_len = 0;
+    return err;
+}
+
+static esp_err_t ota_delta_reserve(ota_delta_t *delta, uint32_t len) {
+    if (delta->produced + len > delta->target_size) {
+        ESP_LOGE(TAG, "Error: el parche genera más datos que la imagen nueva.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    delta->produced += len;
+    return ESP_OK;
+}
+
+static esp_err_t ota_delta_insert(ota_delta_t *delta, const char *data, size_t len) {
+    while (len > 0) {
+        size_t chunk = OTA_DELTA_OUT_SIZE - delta->out_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(delta->out + delta->out_len, data, chunk);
+        delta->out_len += chunk;
+        data += chunk;
+        len -= chunk;
+        if (delta->out_len == OTA_DELTA_OUT_SIZE) {
+            esp_err_t err = ota_delta_flush(delta);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+// Copia un tramo de la partición en ejecución a la imagen nueva
+static esp_err_t ota_delta_copy(ota_delta_t *delta, uint32_t offset, uint32_t len) {
+    if (offset > delta->base_size || len > delta->base_size - offset) {
+        ESP_LOGE(TAG, "Error: el parche copia fuera de la imagen base.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    esp_err_t err = ota_delta_reserve(delta, len);
+    while (err == ESP_OK && len > 0) {
+        size_t chunk = OTA_DELTA_OUT_SIZE - delta->out_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        err = esp_partition_read(delta->base, offset, delta->out + delta->out_len, chunk);
+        delta->out_len += chunk;
+        offset += chunk;
+        len -= chunk;
+        if (err == ESP_OK && delta->out_len == OTA_DELTA_OUT_SIZE) {
+            err = ota_delta_flush(delta);
+        }
+    }
+    return err;
+}
+
+// Comprueba que el parche produce la imagen del manifiesto a partir de la
+// aplicación en ejecución
+static esp_err_t ota_delta_check_header(ota_delta_t *delta) {
+    const uint8_t *hdr = delta->acc;
+    if (memcmp(hdr, OTA_DELTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Error: el fichero descargado no es un parche delta.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    delta->base_size = ota_delta_u32(hdr + 4);
+    delta->target_size = ota_delta_u32(hdr + 8);
+    if (delta->target_size != (uint32_t)delta->manifest->size ||
+        memcmp(hdr + 44, delta->manifest->sha256, 32) != 0) {
+        ESP_LOGE(TAG, "Error: el parche no corresponde a la imagen del manifiesto.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (delta->base_size > delta->base->size) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    // El búfer de salida aún está vacío, se usa para leer la partición
+    uint8_t digest[32];
+    esp_err_t err = ota_partition_sha256(delta->base, delta->base_size, delta->out, OTA_DELTA_OUT_SIZE, digest);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (memcmp(digest, hdr + 12, sizeof(digest)) != 0) {
+        ESP_LOGW(TAG, "La partición %s no es la base del parche.", delta->base->label);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+// Ejecuta la operación cuyos argumentos ya están completos en `acc`
+static esp_err_t ota_delta_run_op(ota_delta_t *delta) {
+    if (delta->op == OTA_DELTA_OP_COPY) {
+        delta->state = DELTA_OP;
+        return ota_delta_copy(delta, ota_delta_u32(delta->acc), ota_delta_u32(delta->acc + 4));
+    }
+
+    delta->insert_left = ota_delta_u32(delta->acc);
+    delta->state = delta->insert_left > 0 ? DELTA_INSERT : DELTA_OP;
+    return ota_delta_reserve(delta, delta->insert_left);
+}
+
+esp_err_t ota_delta_feed(ota_delta_t *delta, const char *data, size_t len) {
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK) {
+        switch (delta->state) {
+        case DELTA_HEADER:
+        case DELTA_ARGS: {
+            size_t chunk = delta->acc_need - delta->acc_len;
+            if (chunk > len) {
+                chunk = len;
+            }
+            memcpy(delta->acc + delta->acc_len, data, chunk);
+            delta->acc_len += chunk;
+            data += chunk;
+            len -= chunk;
+            if (delta->acc_len < delta->acc_need) {
+                break;
+            }
+            if (delta->state == DELTA_HEADER) {
+                err = ota_delta_check_header(delta);
+                delta->state = DELTA_OP;
+            } else {
+                err = ota_delta_run_op(delta);
+            }
+            break;
+        }
+
+        case DELTA_OP:
+            if (delta->produced == delta->target_size) {
+                ESP_LOGE(TAG, "Error: datos sobrantes al final del parche.");
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            delta->op = (uint8_t)*data++;
+            len--;
+            if (delta->op == OTA_DELTA_OP_COPY) {
+                delta->acc_need = 8;
+            } else if (delta->op == OTA_DELTA_OP_INSERT) {
+                delta->acc_need = 4;
+            } else {
+                ESP_LOGE(TAG, "Error: operación 0x%02x desconocida en el parche.", delta->op);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            delta->acc_len = 0;
+            delta->state = DELTA_ARGS;
+            break;
+
+        case DELTA_INSERT: {
+            size_t chunk = delta->insert_left < len ? delta->insert_left : len;
+            err = ota_delta_insert(delta, data, chunk);
+            data += chunk;
+            len -= chunk;
+            delta->insert_left -= chunk;
+            if (delta->insert_left == 0) {
+                delta->state = DELTA_OP;
+            }
+            break;
+        }
+        }
+    }
+    return err;
+}
+
+esp_err_t ota_delta_finish(ota_delta_t *delta) {
+    if (delta->state != DELTA_OP || delta->produced != delta->target_size) {
+        ESP_LOGE(TAG, "Error: el parche está incompleto.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ota_delta_flush(delta);
+}
+
+ota_delta_t *ota_delta_create(const esp_partition_t *base, const ota_manifest_t *manifest,
+                              ota_output_fn output, void *output_ctx) {
+    ota_delta_t *delta = calloc(1, sizeof(ota_delta_t));
+    if (delta == NULL) {
+        return NULL;
+    }
+    delta->out = malloc(OTA_DELTA_OUT_SIZE);
+    if (delta->out == NULL) {
+        free(delta);
+        return NULL;
+    }
+
+    delta->base = base;
+    delta->manifest = manifest;
+    delta->output = output;
+    delta->output_ctx = output_ctx;
+    delta->state = DELTA_HEADER;
+    delta->acc_need = OTA_DELTA_HEADER_LEN;
+    return delta;
+}
+
+void ota_delta_destroy(ota_delta_t *delta) {
+    if (delta != NULL) {
+        free(delta->out);
+        free(delta);
+    }
+}
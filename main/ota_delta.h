@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_update.h"
+
+// Aplica en streaming un parche generado por tools/ota_delta.py. Las
+// operaciones COPY leen de la partición en ejecución y las INSERT toman los
+// datos del propio parche; el resultado se entrega en bloques a `output`.
+
+typedef struct ota_delta ota_delta_t;
+
+ota_delta_t *ota_delta_create(const esp_partition_t *base, const ota_manifest_t *manifest,
+                              ota_output_fn output, void *output_ctx);
+
+// Procesa el siguiente trozo del parche. Devuelve ESP_ERR_INVALID_VERSION si la
+// partición en ejecución no es la base del parche.
+esp_err_t ota_delta_feed(ota_delta_t *delta, const char *data, size_t len);
+
+// Entrega los datos pendientes y comprueba que la imagen está completa
+esp_err_t ota_delta_finish(ota_delta_t *delta);
+
+void ota_delta_destroy(ota_delta_t *delta);
@@ -0,0 +1,150 @@
+#include <string.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "miniz.h"
+#include "ota_inflate.h"
+
+#define OTA_INFLATE_MAGIC "OTAZ"
+#define OTA_INFLATE_VERSION 1
+#define OTA_INFLATE_HEADER_LEN 44 // magic + version + window_bits + reservado + tamaño + SHA-256
+
+static const char *TAG = "OTA";
+
+struct ota_inflate {
+    const ota_manifest_t *manifest;
+    ota_output_fn output;
+    void *output_ctx;
+
+    uint8_t header[OTA_INFLATE_HEADER_LEN];
+    size_t header_len;
+
+    tinfl_decompressor inflator;
+    uint8_t *dict;      // Ventana circular: también es el búfer de salida
+    size_t dict_size;
+    size_t dict_ofs;
+    size_t produced;
+    bool done;
+};
+
+static uint32_t ota_inflate_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static esp_err_t ota_inflate_check_header(ota_inflate_t *inflate) {
+    const uint8_t *hdr = inflate->header;
+    uint8_t window_bits = hdr[5];
+
+    if (memcmp(hdr, OTA_INFLATE_MAGIC, 4) != 0 || hdr[4] != OTA_INFLATE_VERSION) {
+        ESP_LOGE(TAG, "Error: el fichero descargado no es una imagen comprimida.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (ota_inflate_u32(hdr + 8) != (uint32_t)inflate->manifest->size ||
+        memcmp(hdr + 12, inflate->manifest->sha256, 32) != 0) {
+        ESP_LOGE(TAG, "Error: la imagen comprimida no corresponde al manifiesto.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (window_bits < 9 || window_bits > CONFIG_OTA_COMPRESSED_MAX_WINDOW_BITS) {
+        ESP_LOGE(TAG, "Error: ventana de %u bits no admitida (máximo %d).",
+                 window_bits, CONFIG_OTA_COMPRESSED_MAX_WINDOW_BITS);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    inflate->dict_size = (size_t)1 << window_bits;
+    inflate->dict = malloc(inflate->dict_size);
+    if (inflate->dict == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tinfl_init(&inflate->inflator);
+    return ESP_OK;
+}
+
+static esp_err_t ota_inflate_data(ota_inflate_t *inflate, const char *data, size_t len) {
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+    // HAS_MORE_OUTPUT indica que la ventana se llenó antes de consumir la entrada
+    while (len > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+        if (inflate->done) {
+            ESP_LOGE(TAG, "Error: datos sobrantes tras el final de la imagen comprimida.");
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        size_t in_bytes = len;
+        size_t out_bytes = inflate->dict_size - inflate->dict_ofs;
+        status = tinfl_decompress(&inflate->inflator, (const mz_uint8 *)data, &in_bytes, inflate->dict,
+                                  inflate->dict + inflate->dict_ofs, &out_bytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        len -= in_bytes;
+
+        if (out_bytes > 0) {
+            if (inflate->produced + out_bytes > (size_t)inflate->manifest->size) {
+                ESP_LOGE(TAG, "Error: la imagen descomprimida es mayor que la indicada.");
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            esp_err_t err = inflate->output(inflate->output_ctx, (const char *)inflate->dict + inflate->dict_ofs,
+                                            out_bytes);
+            if (err != ESP_OK) {
+                return err;
+            }
+            inflate->produced += out_bytes;
+            inflate->dict_ofs = (inflate->dict_ofs + out_bytes) & (inflate->dict_size - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Error descomprimiendo la imagen (%d).", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            inflate->done = true;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *inflate, const char *data, size_t len) {
+    if (inflate->header_len < OTA_INFLATE_HEADER_LEN) {
+        size_t chunk = OTA_INFLATE_HEADER_LEN - inflate->header_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(inflate->header + inflate->header_len, data, chunk);
+        inflate->header_len += chunk;
+        data += chunk;
+        len -= chunk;
+        if (inflate->header_len < OTA_INFLATE_HEADER_LEN) {
+            return ESP_OK;
+        }
+        esp_err_t err = ota_inflate_check_header(inflate);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ota_inflate_data(inflate, data, len);
+}
+
+esp_err_t ota_inflate_finish(ota_inflate_t *inflate) {
+    if (!inflate->done || inflate->produced != (size_t)inflate->manifest->size) {
+        ESP_LOGE(TAG, "Error: la imagen comprimida está incompleta.");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+ota_inflate_t *ota_inflate_create(const ota_manifest_t *manifest, ota_output_fn output, void *output_ctx) {
+    // tinfl_decompressor ocupa unos 11 KB, mejor en el heap que en la pila
+    ota_inflate_t *inflate = calloc(1, sizeof(ota_inflate_t));
+    if (inflate == NULL) {
+        return NULL;
+    }
+    inflate->manifest = manifest;
+    inflate->output = output;
+    inflate->output_ctx = output_ctx;
+    return inflate;
+}
+
+void ota_inflate_destroy(ota_inflate_t *inflate) {
+    if (inflate != NULL) {
+        free(inflate->dict);
+        free(inflate);
+    }
+}
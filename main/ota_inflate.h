@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "ota_update.h"
+
+// Descomprime en streaming una imagen generada por tools/ota_pack.py usando el
+// inflate (tinfl) de la ROM. Solo se reserva un diccionario de 2^window_bits
+// bytes; la imagen descomprimida se entrega en trozos a `output`.
+
+typedef struct ota_inflate ota_inflate_t;
+
+ota_inflate_t *ota_inflate_create(const ota_manifest_t *manifest, ota_output_fn output, void *output_ctx);
+
+// Procesa el siguiente trozo del fichero comprimido
+esp_err_t ota_inflate_feed(ota_inflate_t *inflate, const char *data, size_t len);
+
+// Comprueba que el flujo deflate terminó con el tamaño esperado
+esp_err_t ota_inflate_finish(ota_inflate_t *inflate);
+
+void ota_inflate_destroy(ota_inflate_t *inflate);
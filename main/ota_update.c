@@ -0,0 +1,686 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "spi_flash_mmap.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+#include "http_conn.h"
+#include "ota_delta.h"
+#include "ota_inflate.h"
+#include "ota_update.h"
+
+#define OTA_BLOCK_SIZE CONFIG_OTA_BLOCK_SIZE
+#define OTA_NUM_BUFFERS 2 // Doble buffer: uno se recibe mientras el otro se escribe
+#define OTA_QUEUE_TIMEOUT pdMS_TO_TICKS(30000)
+#define OTA_PROGRESS_INTERVAL_US ((int64_t)CONFIG_OTA_PROGRESS_INTERVAL_MS * 1000)
+#define OTA_SECTOR_ALIGN_DOWN(x) ((x) & ~(SPI_FLASH_SEC_SIZE - 1))
+#define OTA_SECTOR_ALIGN_UP(x) OTA_SECTOR_ALIGN_DOWN((x) + SPI_FLASH_SEC_SIZE - 1)
+
+// Claves NVS del progreso de una descarga interrumpida
+#define OTA_NVS_RESUME_SHA_KEY "rs_sha"
+#define OTA_NVS_RESUME_PART_KEY "rs_part"
+#define OTA_NVS_RESUME_OFFSET_KEY "rs_off"
+
+// Claves NVS de los intentos fallidos con un formato que no se puede continuar
+#define OTA_NVS_FAILED_SHA_KEY "nr_sha"
+#define OTA_NVS_FAILED_COUNT_KEY "nr_fail"
+
+static const char *TAG = "OTA";
+
+// Formato del fichero descargado
+typedef enum {
+    OTA_FORMAT_RAW,         // Imagen .bin tal cual
+    OTA_FORMAT_DELTA,       // Parche de tools/ota_delta.py
+    OTA_FORMAT_COMPRESSED,  // Imagen comprimida de tools/ota_pack.py
+} ota_format_t;
+
+// Bloque de datos que circula entre la tarea de descarga y la de escritura.
+// Un bloque con len == 0 marca el final de la imagen.
+typedef struct {
+    char *data;
+    int len;
+} ota_block_t;
+
+// Estado compartido entre la tarea de descarga y la tarea de escritura
+typedef struct {
+    const esp_partition_t *partition;
+    QueueHandle_t free_queue;  // Bloques vacíos listos para recibir datos
+    QueueHandle_t full_queue;  // Bloques con datos pendientes de escribir
+    SemaphoreHandle_t done;    // Se libera cuando la escritura ha terminado
+    volatile esp_err_t write_err;
+    ota_output_fn feed;        // Recibe los datos descargados (imagen, parche o imagen comprimida)
+    void *feed_ctx;
+    esp_err_t (*finish)(void *ctx); // Cierra el decodificador; NULL para la imagen sin procesar
+    void (*destroy)(void *ctx);
+    size_t received;           // Bytes recibidos del servidor, incluidos los de antes de continuar
+    nvs_handle_t nvs;          // Para guardar el progreso; 0 si NVS no está disponible
+    size_t offset;             // Siguiente posición a escribir en la partición
+    size_t erased_end;         // Todo lo anterior a esta posición ya está borrado
+    size_t saved_offset;       // Último progreso guardado en NVS
+    int64_t erase_us;          // Tiempo total borrando sectores
+    int64_t write_us;          // Tiempo total escribiendo en flash
+} ota_pipeline_t;
+
+// Duración de las fases de una descarga. Se registra en una línea
+// "OTA_METRICS clave=valor ..." que lee tools/ota_bench.py.
+typedef struct {
+    int64_t start_us;
+    int64_t connect_us;        // DNS + TCP + TLS de la conexión usada, aunque la abriera la consulta
+    bool reused;               // La conexión venía abierta de la consulta del manifiesto
+    int64_t first_byte_us;     // Desde la petición hasta recibir las cabeceras
+    int64_t verify_us;
+    size_t heap_free_start;
+    bool heap_monitor;         // Mínimo de heap medido solo durante la descarga
+} ota_metrics_t;
+
+// Guarda en NVS hasta dónde está escrita la imagen. Se redondea al sector para
+// que al continuar se borre y reescriba el sector que pudo quedar a medias.
+static void ota_resume_save(ota_pipeline_t *pipe) {
+    uint32_t offset = OTA_SECTOR_ALIGN_DOWN(pipe->offset);
+    if (pipe->nvs == 0 || offset == pipe->saved_offset) {
+        return;
+    }
+    if (nvs_set_u32(pipe->nvs, OTA_NVS_RESUME_OFFSET_KEY, offset) == ESP_OK &&
+        nvs_commit(pipe->nvs) == ESP_OK) {
+        pipe->saved_offset = offset;
+    }
+}
+
+// Registra la imagen que se empieza a descargar desde cero
+static void ota_resume_start(nvs_handle_t nvs, const ota_manifest_t *manifest,
+                             const esp_partition_t *partition) {
+    nvs_set_blob(nvs, OTA_NVS_RESUME_SHA_KEY, manifest->sha256, sizeof(manifest->sha256));
+    nvs_set_u32(nvs, OTA_NVS_RESUME_PART_KEY, partition->address);
+    nvs_set_u32(nvs, OTA_NVS_RESUME_OFFSET_KEY, 0);
+    nvs_commit(nvs);
+}
+
+// Devuelve desde dónde se puede continuar la descarga de esta imagen en esta partición
+static size_t ota_resume_load(nvs_handle_t nvs, const ota_manifest_t *manifest,
+                              const esp_partition_t *partition) {
+    uint8_t sha256[sizeof(manifest->sha256)];
+    size_t sha_len = sizeof(sha256);
+    uint32_t address = 0;
+    uint32_t offset = 0;
+
+    if (nvs == 0 ||
+        nvs_get_blob(nvs, OTA_NVS_RESUME_SHA_KEY, sha256, &sha_len) != ESP_OK ||
+        nvs_get_u32(nvs, OTA_NVS_RESUME_PART_KEY, &address) != ESP_OK ||
+        nvs_get_u32(nvs, OTA_NVS_RESUME_OFFSET_KEY, &offset) != ESP_OK) {
+        return 0;
+    }
+    if (sha_len != sizeof(sha256) || memcmp(sha256, manifest->sha256, sizeof(sha256)) != 0 ||
+        address != partition->address || offset >= (uint32_t)manifest->size) {
+        return 0;
+    }
+    return OTA_SECTOR_ALIGN_DOWN(offset);
+}
+
+bool ota_resume_pending(const ota_manifest_t *manifest) {
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    nvs_handle_t nvs;
+    if (partition == NULL || nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t offset = ota_resume_load(nvs, manifest, partition);
+    nvs_close(nvs);
+    return offset > 0;
+}
+
+unsigned ota_unresumable_failures(const ota_manifest_t *manifest) {
+    uint8_t sha256[sizeof(manifest->sha256)];
+    size_t sha_len = sizeof(sha256);
+    uint8_t failures = 0;
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return 0;
+    }
+    // El contador es de una imagen concreta: con una versión nueva se empieza de cero
+    if (nvs_get_blob(nvs, OTA_NVS_FAILED_SHA_KEY, sha256, &sha_len) != ESP_OK ||
+        sha_len != sizeof(sha256) || memcmp(sha256, manifest->sha256, sizeof(sha256)) != 0 ||
+        nvs_get_u8(nvs, OTA_NVS_FAILED_COUNT_KEY, &failures) != ESP_OK) {
+        failures = 0;
+    }
+    nvs_close(nvs);
+    return failures;
+}
+
+void ota_unresumable_failed(const ota_manifest_t *manifest) {
+    unsigned failures = ota_unresumable_failures(manifest);
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    nvs_set_blob(nvs, OTA_NVS_FAILED_SHA_KEY, manifest->sha256, sizeof(manifest->sha256));
+    nvs_set_u8(nvs, OTA_NVS_FAILED_COUNT_KEY, failures < UINT8_MAX ? failures + 1 : UINT8_MAX);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void ota_resume_clear(nvs_handle_t nvs) {
+    if (nvs == 0) {
+        return;
+    }
+    nvs_erase_key(nvs, OTA_NVS_RESUME_SHA_KEY);
+    nvs_erase_key(nvs, OTA_NVS_RESUME_PART_KEY);
+    nvs_erase_key(nvs, OTA_NVS_RESUME_OFFSET_KEY);
+    nvs_commit(nvs);
+}
+
+// Escribe datos de la imagen en la posición actual, borrando antes los sectores nuevos
+static esp_err_t ota_write_output(void *ctx, const char *data, size_t len) {
+    ota_pipeline_t *pipe = (ota_pipeline_t *)ctx;
+    size_t end = pipe->offset + len;
+    if (end > pipe->erased_end) {
+        size_t erase_end = OTA_SECTOR_ALIGN_UP(end);
+        int64_t erase_start = esp_timer_get_time();
+        esp_err_t err = esp_partition_erase_range(pipe->partition, pipe->erased_end,
+                                                  erase_end - pipe->erased_end);
+        pipe->erase_us += esp_timer_get_time() - erase_start;
+        if (err != ESP_OK) {
+            return err;
+        }
+        pipe->erased_end = erase_end;
+    }
+
+    int64_t write_start = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(pipe->partition, pipe->offset, data, len);
+    pipe->write_us += esp_timer_get_time() - write_start;
+    if (err != ESP_OK) {
+        return err;
+    }
+    pipe->offset = end;
+
+    if (pipe->offset - pipe->saved_offset >= CONFIG_OTA_RESUME_SAVE_INTERVAL) {
+        ota_resume_save(pipe);
+    }
+    return ESP_OK;
+}
+
+// Tarea que escribe en flash los bloques recibidos. El borrado de cada sector
+// también ocurre aquí, solapado con la descarga.
+static void ota_writer_task(void *arg) {
+    ota_pipeline_t *pipe = (ota_pipeline_t *)arg;
+    ota_block_t block;
+
+    while (xQueueReceive(pipe->full_queue, &block, portMAX_DELAY) == pdTRUE) {
+        if (block.len == 0) {
+            break;
+        }
+
+        // Tras un error se siguen devolviendo bloques para no bloquear la descarga
+        if (pipe->write_err == ESP_OK) {
+            esp_err_t err = pipe->feed(pipe->feed_ctx, block.data, block.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Error al escribir en la partición OTA: %s", esp_err_to_name(err));
+                pipe->write_err = err;
+            }
+        }
+        xQueueSend(pipe->free_queue, &block, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(pipe->done);
+    vTaskDelete(NULL);
+}
+
+// Lee del cliente HTTP hasta llenar el bloque o llegar al final del cuerpo.
+// Con TLS cada lectura devuelve como mucho un registro, por eso se repite.
+static int ota_fill_block(esp_http_client_handle_t client, char *data, int size) {
+    int filled = 0;
+    while (filled < size) {
+        int read = esp_http_client_read(client, data + filled, size - filled);
+        if (read < 0) {
+            return read;
+        }
+        if (read == 0) {
+            break;
+        }
+        filled += read;
+    }
+    return filled;
+}
+
+static void ota_log_progress(size_t received, int total) {
+    if (total > 0) {
+        ESP_LOGI(TAG, "Progreso: %u/%d bytes (%d%%)", (unsigned)received, total,
+                 (int)((uint64_t)received * 100 / total));
+    } else {
+        ESP_LOGI(TAG, "Progreso: %u bytes", (unsigned)received);
+    }
+}
+
+// Recibe el cuerpo de la respuesta y lo pasa bloque a bloque a la tarea de escritura
+static esp_err_t ota_stream_image(esp_http_client_handle_t client, ota_pipeline_t *pipe, int total) {
+    int64_t last_progress = esp_timer_get_time();
+    size_t received = pipe->received;
+    ota_block_t block;
+    esp_err_t err = ESP_OK;
+
+    while (pipe->write_err == ESP_OK) {
+        if (xQueueReceive(pipe->free_queue, &block, OTA_QUEUE_TIMEOUT) != pdTRUE) {
+            ESP_LOGE(TAG, "Error: la escritura en flash no avanza.");
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+
+        block.len = ota_fill_block(client, block.data, OTA_BLOCK_SIZE);
+        if (block.len < 0) {
+            ESP_LOGE(TAG, "Error leyendo datos del servidor.");
+            xQueueSend(pipe->free_queue, &block, 0);
+            err = ESP_FAIL;
+            break;
+        }
+        if (block.len == 0) {
+            xQueueSend(pipe->free_queue, &block, 0);
+            break;
+        }
+
+        received += block.len;
+        xQueueSend(pipe->full_queue, &block, portMAX_DELAY);
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_progress >= OTA_PROGRESS_INTERVAL_US) {
+            ota_log_progress(received, total);
+            last_progress = now;
+        }
+    }
+
+    // Marca de fin para la tarea de escritura; la cola tiene un hueco reservado para ella
+    ota_block_t end = { .data = NULL, .len = 0 };
+    xQueueSend(pipe->full_queue, &end, portMAX_DELAY);
+    xSemaphoreTake(pipe->done, portMAX_DELAY);
+
+    pipe->received = received;
+    if (err == ESP_OK && pipe->write_err != ESP_OK) {
+        err = pipe->write_err;
+    }
+    if (err == ESP_OK && (!esp_http_client_is_complete_data_received(client) || received != (size_t)total)) {
+        ESP_LOGE(TAG, "Error: la descarga terminó antes de recibir la imagen completa.");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    // La tarea de escritura ya terminó: los últimos datos del decodificador se escriben desde aquí
+    if (err == ESP_OK && pipe->finish != NULL) {
+        err = pipe->finish(pipe->feed_ctx);
+    }
+    return err;
+}
+
+esp_err_t ota_partition_sha256(const esp_partition_t *partition, size_t size, char *buffer,
+                               size_t buffer_size, uint8_t digest[32]) {
+    mbedtls_sha256_context ctx;
+    esp_err_t err = ESP_OK;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (size_t pos = 0; pos < size && err == ESP_OK; pos += buffer_size) {
+        size_t len = size - pos;
+        if (len > buffer_size) {
+            len = buffer_size;
+        }
+        err = esp_partition_read(partition, pos, buffer, len);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&ctx, (const unsigned char *)buffer, len);
+        }
+    }
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    return err;
+}
+
+// Calcula el SHA-256 de la imagen ya escrita en la partición
+static esp_err_t ota_verify_image(const esp_partition_t *partition, const ota_manifest_t *manifest,
+                                  char *buffer) {
+    uint8_t digest[32];
+    esp_err_t err = ota_partition_sha256(partition, manifest->size, buffer, OTA_BLOCK_SIZE, digest);
+    if (err == ESP_OK && memcmp(digest, manifest->sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Error: el SHA-256 de la imagen descargada no coincide con el manifiesto.");
+        err = ESP_ERR_INVALID_CRC;
+    }
+    return err;
+}
+
+static void ota_pipeline_free(ota_pipeline_t *pipe, char *buffers[]) {
+    if (pipe->destroy != NULL) {
+        pipe->destroy(pipe->feed_ctx);
+    }
+    for (int i = 0; i < OTA_NUM_BUFFERS; i++) {
+        free(buffers[i]);
+    }
+    if (pipe->free_queue) {
+        vQueueDelete(pipe->free_queue);
+    }
+    if (pipe->full_queue) {
+        vQueueDelete(pipe->full_queue);
+    }
+    if (pipe->done) {
+        vSemaphoreDelete(pipe->done);
+    }
+}
+
+static esp_err_t ota_pipeline_init(ota_pipeline_t *pipe, char *buffers[]) {
+    pipe->free_queue = xQueueCreate(OTA_NUM_BUFFERS, sizeof(ota_block_t));
+    pipe->full_queue = xQueueCreate(OTA_NUM_BUFFERS + 1, sizeof(ota_block_t));
+    pipe->done = xSemaphoreCreateBinary();
+    if (pipe->free_queue == NULL || pipe->full_queue == NULL || pipe->done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < OTA_NUM_BUFFERS; i++) {
+        buffers[i] = malloc(OTA_BLOCK_SIZE);
+        if (buffers[i] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        ota_block_t block = { .data = buffers[i], .len = 0 };
+        xQueueSend(pipe->free_queue, &block, 0);
+    }
+    return ESP_OK;
+}
+
+// Abre la conexión pidiendo el fichero desde `resume_offset`. Devuelve en
+// `start_offset` la posición desde la que el servidor envía realmente los datos.
+static esp_err_t ota_open_image(http_conn_t *conn, size_t size,
+                                size_t resume_offset, size_t *start_offset) {
+    if (resume_offset > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%u-", (unsigned)resume_offset);
+        http_conn_set_header(conn, "Range", range);
+    }
+
+    int content_length;
+    esp_err_t err = http_conn_open(conn, &content_length);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error conectando con el servidor: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    int status = esp_http_client_get_status_code(http_conn_client(conn));
+    if (status == 206 && resume_offset > 0) {
+        *start_offset = resume_offset;
+    } else if (status == 200) {
+        if (resume_offset > 0) {
+            ESP_LOGW(TAG, "El servidor no admite Range, la descarga empieza de cero.");
+        }
+        *start_offset = 0;
+    } else {
+        // 4xx: el fichero no existe o no se puede servir, reintentar no sirve de nada
+        ESP_LOGE(TAG, "Error: respuesta HTTP %d.", status);
+        return status >= 400 && status < 500 ? ESP_ERR_INVALID_RESPONSE : ESP_FAIL;
+    }
+
+    if (content_length > 0 && *start_offset + content_length != size) {
+        ESP_LOGE(TAG, "Error: el servidor envía %d bytes desde %u, el manifiesto indica %u.",
+                 content_length, (unsigned)*start_offset, (unsigned)size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_delta_feed_cb(void *ctx, const char *data, size_t len) {
+    return ota_delta_feed((ota_delta_t *)ctx, data, len);
+}
+
+static esp_err_t ota_delta_finish_cb(void *ctx) {
+    return ota_delta_finish((ota_delta_t *)ctx);
+}
+
+static void ota_delta_destroy_cb(void *ctx) {
+    ota_delta_destroy((ota_delta_t *)ctx);
+}
+
+static esp_err_t ota_inflate_feed_cb(void *ctx, const char *data, size_t len) {
+    return ota_inflate_feed((ota_inflate_t *)ctx, data, len);
+}
+
+static esp_err_t ota_inflate_finish_cb(void *ctx) {
+    return ota_inflate_finish((ota_inflate_t *)ctx);
+}
+
+static void ota_inflate_destroy_cb(void *ctx) {
+    ota_inflate_destroy((ota_inflate_t *)ctx);
+}
+
+// Prepara el decodificador del formato descargado. La imagen sin procesar se
+// escribe directamente en la partición.
+static esp_err_t ota_pipeline_set_format(ota_pipeline_t *pipe, ota_format_t format,
+                                         const ota_manifest_t *manifest) {
+    pipe->feed = ota_write_output;
+    pipe->feed_ctx = pipe;
+
+    if (format == OTA_FORMAT_DELTA) {
+        ota_delta_t *delta = ota_delta_create(esp_ota_get_running_partition(), manifest, ota_write_output, pipe);
+        if (delta == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        pipe->feed = ota_delta_feed_cb;
+        pipe->finish = ota_delta_finish_cb;
+        pipe->destroy = ota_delta_destroy_cb;
+        pipe->feed_ctx = delta;
+    } else if (format == OTA_FORMAT_COMPRESSED) {
+        ota_inflate_t *inflate = ota_inflate_create(manifest, ota_write_output, pipe);
+        if (inflate == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        pipe->feed = ota_inflate_feed_cb;
+        pipe->finish = ota_inflate_finish_cb;
+        pipe->destroy = ota_inflate_destroy_cb;
+        pipe->feed_ctx = inflate;
+    }
+    return ESP_OK;
+}
+
+static void ota_metrics_start(ota_metrics_t *metrics) {
+    metrics->start_us = esp_timer_get_time();
+    metrics->heap_free_start = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    metrics->heap_monitor = heap_caps_monitor_local_minimum_free_size_start() == ESP_OK;
+}
+
+static void ota_metrics_log(ota_metrics_t *metrics, const ota_pipeline_t *pipe, ota_format_t format,
+                            const char *url, size_t downloaded, esp_err_t err) {
+    static const char *format_keys[] = {
+        [OTA_FORMAT_RAW] = "raw",
+        [OTA_FORMAT_DELTA] = "delta",
+        [OTA_FORMAT_COMPRESSED] = "compressed",
+    };
+    size_t heap_peak = 0;
+    if (metrics->heap_monitor) {
+        heap_peak = metrics->heap_free_start - heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+        heap_caps_monitor_local_minimum_free_size_stop();
+    }
+
+    ESP_LOGI(TAG, "OTA_METRICS format=%s result=%s tls=%d bytes=%u connect_ms=%lld reused=%d first_byte_ms=%lld "
+             "erase_ms=%lld write_ms=%lld verify_ms=%lld total_ms=%lld heap_peak=%u",
+             format_keys[format], esp_err_to_name(err), strncmp(url, "https:", 6) == 0, (unsigned)downloaded,
+             metrics->connect_us / 1000, metrics->reused, metrics->first_byte_us / 1000, pipe->erase_us / 1000,
+             pipe->write_us / 1000, metrics->verify_us / 1000,
+             (esp_timer_get_time() - metrics->start_us) / 1000, (unsigned)heap_peak);
+}
+
+// Descarga la imagen completa, el parche o la imagen comprimida del manifiesto
+// y escribe el resultado en la siguiente partición OTA
+static esp_err_t ota_download(const char *url, const ota_manifest_t *manifest, ota_format_t format) {
+    static const char *format_names[] = {
+        [OTA_FORMAT_RAW] = "",
+        [OTA_FORMAT_DELTA] = " delta",
+        [OTA_FORMAT_COMPRESSED] = " comprimida",
+    };
+    ESP_LOGI(TAG, "Iniciando la actualización%s desde: %s", format_names[format], url);
+
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Error: No hay partición para actualizaciones.");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (manifest->size <= 0 || manifest->size > (int)update_partition->size) {
+        ESP_LOGE(TAG, "Error: la imagen (%d bytes) no cabe en la partición %s.",
+                 manifest->size, update_partition->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t payload_size = (size_t)manifest->size;
+    if (format == OTA_FORMAT_DELTA) {
+        payload_size = (size_t)manifest->patch_size;
+    } else if (format == OTA_FORMAT_COMPRESSED) {
+        payload_size = (size_t)manifest->compressed_size;
+    }
+
+    // Normalmente es la conexión que dejó abierta la consulta del manifiesto
+    http_conn_t *conn = http_conn_acquire(url, HTTP_METHOD_GET, NULL, NULL);
+    if (conn == NULL) {
+        return ESP_FAIL;
+    }
+    esp_http_client_handle_t client = http_conn_client(conn);
+    bool opened = false;
+    ota_metrics_t metrics = { 0 };
+
+    ota_pipeline_t pipe = { .partition = update_partition };
+    char *buffers[OTA_NUM_BUFFERS] = { 0 };
+    nvs_handle_t nvs = 0;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS no disponible, la descarga no se podrá continuar si se interrumpe.");
+        nvs = 0;
+    }
+
+    // Un parche o una imagen comprimida no se pueden continuar a medias
+    size_t resume_offset = 0;
+    if (format == OTA_FORMAT_RAW) {
+        pipe.nvs = nvs;
+        resume_offset = ota_resume_load(nvs, manifest, update_partition);
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t start_offset = 0;
+    ota_metrics_start(&metrics);
+    esp_err_t err = ota_open_image(conn, payload_size, resume_offset, &start_offset);
+    metrics.first_byte_us = esp_timer_get_time() - metrics.start_us;
+    if (err == ESP_OK) {
+        metrics.connect_us = (int64_t)http_conn_connect_ms(conn) * 1000;
+        metrics.reused = http_conn_reused(conn);
+    }
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+    opened = true;
+
+    err = ota_pipeline_init(&pipe, buffers);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error: No se pudo asignar memoria para los buffers.");
+        goto cleanup;
+    }
+
+    err = ota_pipeline_set_format(&pipe, format, manifest);
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+
+    // Se escribe directamente en la partición (esp_ota_write no permite
+    // continuar desde un offset); esp_ota_set_boot_partition valida la imagen.
+    pipe.offset = pipe.erased_end = pipe.saved_offset = pipe.received = start_offset;
+    if (start_offset == 0 && pipe.nvs != 0) {
+        ota_resume_start(pipe.nvs, manifest, update_partition);
+    } else if (format != OTA_FORMAT_RAW) {
+        // Se va a sobrescribir la partición: una descarga pendiente deja de ser válida
+        ota_resume_clear(nvs);
+    }
+
+    if (xTaskCreate(ota_writer_task, "ota_writer", CONFIG_OTA_WRITER_TASK_STACK_SIZE, &pipe,
+                    CONFIG_OTA_WRITER_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Error creando la tarea de escritura.");
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    if (start_offset > 0) {
+        ESP_LOGI(TAG, "Continuando la descarga en la partición %s desde el byte %u...",
+                 update_partition->label, (unsigned)start_offset);
+    } else {
+        ESP_LOGI(TAG, "Descargando el firmware en la partición %s...", update_partition->label);
+    }
+    err = ota_stream_image(client, &pipe, payload_size);
+    if (err != ESP_OK) {
+        // Se conserva lo escrito para continuar en el próximo intento
+        ota_resume_save(&pipe);
+        goto cleanup;
+    }
+    ota_log_progress(pipe.received, payload_size);
+
+    int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    size_t downloaded = pipe.received - start_offset;
+    ESP_LOGI(TAG, "%u bytes descargados, %u escritos en %lld ms (%lld KB/s)", (unsigned)downloaded,
+             (unsigned)(pipe.offset - start_offset), elapsed_ms,
+             elapsed_ms > 0 ? (long long)downloaded * 1000 / 1024 / elapsed_ms : 0LL);
+
+    // Con la imagen completa o corrupta, el próximo intento empieza de cero
+    int64_t verify_start = esp_timer_get_time();
+    err = ota_verify_image(update_partition, manifest, buffers[0]);
+    metrics.verify_us = esp_timer_get_time() - verify_start;
+    ota_resume_clear(nvs);
+    if (err == ESP_ERR_INVALID_CRC && format != OTA_FORMAT_RAW) {
+        // El transporte ya detecta datos corruptos: falla el parche o la imagen comprimida
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+
+    err = esp_ota_set_boot_partition(update_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error seleccionando la partición de arranque: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+    // Imagen instalada: los intentos fallidos anteriores ya no cuentan
+    if (nvs != 0) {
+        nvs_erase_key(nvs, OTA_NVS_FAILED_SHA_KEY);
+        nvs_erase_key(nvs, OTA_NVS_FAILED_COUNT_KEY);
+        nvs_commit(nvs);
+    }
+
+cleanup:
+    ota_pipeline_free(&pipe, buffers);
+    if (nvs != 0) {
+        nvs_close(nvs);
+    }
+    // Una descarga interrumpida deja datos sin leer: se cierra la conexión
+    http_conn_release(conn, opened && esp_http_client_is_complete_data_received(client));
+    if (metrics.start_us != 0) {
+        ota_metrics_log(&metrics, &pipe, format, url,
+                        pipe.received > start_offset ? pipe.received - start_offset : 0, err);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Actualización OTA completada con éxito. Reiniciando...");
+
+        // Reiniciar el dispositivo
+        esp_restart();
+    }
+    return err;
+}
+
+// Función para realizar la actualización OTA
+esp_err_t perform_ota_update(const char *url, const ota_manifest_t *manifest) {
+    return ota_download(url, manifest, OTA_FORMAT_RAW);
+}
+
+esp_err_t perform_ota_delta_update(const ota_manifest_t *manifest) {
+    if (manifest->patch_url[0] == '\0') {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ota_download(manifest->patch_url, manifest, OTA_FORMAT_DELTA);
+}
+
+esp_err_t perform_ota_compressed_update(const ota_manifest_t *manifest) {
+    if (manifest->compressed_url[0] == '\0') {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ota_download(manifest->compressed_url, manifest, OTA_FORMAT_COMPRESSED);
+}
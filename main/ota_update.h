@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_check.h"
+
+// Destino de los datos de la imagen que producen los decodificadores
+// (parche delta, imagen comprimida)
+typedef esp_err_t (*ota_output_fn)(void *ctx, const char *data, size_t len);
+
+// Descarga el firmware descrito por `manifest` desde `url` en bloques de
+// CONFIG_OTA_BLOCK_SIZE y lo escribe en la siguiente partición OTA. Una tarea
+// recibe de la red mientras otra escribe en flash (doble buffer). El progreso
+// se guarda en NVS, así que una descarga interrumpida continúa con una
+// petición `Range:` desde el último bloque escrito. Antes de cambiar la
+// partición de arranque se comprueba el SHA-256 de la imagen completa.
+// Si termina bien, reinicia el equipo.
+esp_err_t perform_ota_update(const char *url, const ota_manifest_t *manifest);
+
+// Igual que perform_ota_update, pero descarga el parche delta del manifiesto
+// (manifest->patch_url) y lo aplica sobre la partición en ejecución. Devuelve
+// ESP_ERR_INVALID_VERSION si la aplicación en ejecución no es la base del parche
+// y ESP_ERR_INVALID_RESPONSE si el servidor no tiene el parche o está mal
+// formado; en esos casos conviene descargar la imagen completa. Los errores de
+// red se devuelven tal cual y no tocan una descarga completa pendiente.
+esp_err_t perform_ota_delta_update(const ota_manifest_t *manifest);
+
+// Igual que perform_ota_update, pero descarga la imagen comprimida del
+// manifiesto (manifest->compressed_url) y la descomprime mientras la escribe.
+// Los errores se devuelven como en perform_ota_delta_update.
+esp_err_t perform_ota_compressed_update(const ota_manifest_t *manifest);
+
+// Indica si hay una descarga de la imagen completa de `manifest` a medias que
+// perform_ota_update puede continuar
+bool ota_resume_pending(const ota_manifest_t *manifest);
+
+// Intentos seguidos de instalar `manifest` con el parche o la imagen
+// comprimida, que no se pueden continuar, que fallaron por un error que no es
+// de formato (normalmente de red). Se guardan en NVS y se ponen a cero al
+// instalar una imagen.
+unsigned ota_unresumable_failures(const ota_manifest_t *manifest);
+void ota_unresumable_failed(const ota_manifest_t *manifest);
+
+// SHA-256 de los primeros `size` bytes de una partición, leídos usando `buffer`
+esp_err_t ota_partition_sha256(const esp_partition_t *partition, size_t size, char *buffer,
+                               size_t buffer_size, uint8_t digest[32]);
@@ -0,0 +1,149 @@
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "ota_check.h"
+#include "ota_update.h"
+#include "ota_worker.h"
+#include "power.h"
+
+#if CONFIG_OTA_WORKER_TASK_CORE < 0
+#define OTA_WORKER_CORE tskNO_AFFINITY
+#else
+#define OTA_WORKER_CORE CONFIG_OTA_WORKER_TASK_CORE
+#endif
+
+static const char *TAG = "OTA";
+
+static TaskHandle_t worker_task = NULL;
+static const char *worker_manifest_url;
+static const char *worker_firmware_url;
+static uint32_t worker_interval_ms;
+static volatile ota_worker_state_t worker_state = OTA_WORKER_IDLE;
+
+// Errores que indican que el formato no sirve (parche para otra base, fichero
+// ausente o corrupto). Con los demás, sobre todo los de red, probar otro
+// formato solo repetiría el fallo.
+static bool ota_worker_format_error(esp_err_t err) {
+    return err == ESP_ERR_INVALID_RESPONSE || err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_NOT_SUPPORTED;
+}
+
+// Función para verificar si hay actualizaciones e instalarlas
+static esp_err_t ota_worker_check(void) {
+    ESP_LOGI(TAG, "Verificando actualizaciones de firmware...");
+    ota_manifest_t manifest;
+    bool update_available = false;
+    esp_err_t err = ota_check_for_update(worker_manifest_url, &manifest, &update_available);
+    if (err != ESP_OK || !update_available) {
+        return err;
+    }
+
+    worker_state = OTA_WORKER_UPDATING;
+
+    // Un parche o la imagen comprimida sobrescribirían lo ya descargado. Y si
+    // se cortan una y otra vez, la imagen completa al menos avanza en cada intento.
+    bool full_only = ota_resume_pending(&manifest);
+    unsigned failures = ota_unresumable_failures(&manifest);
+    if (full_only) {
+        ESP_LOGI(TAG, "Hay una descarga de la imagen completa a medias, se continúa.");
+    } else if (failures >= CONFIG_OTA_UNRESUMABLE_MAX_FAILURES) {
+        ESP_LOGW(TAG, "%u intentos fallidos con el parche o la imagen comprimida, se descarga la imagen "
+                 "completa.", failures);
+        full_only = true;
+    }
+
+    // Un parche que no es menor que la imagen comprimida solo añade trabajo
+    bool use_patch = !full_only && manifest.patch_url[0] != '\0';
+    if (use_patch && manifest.compressed_url[0] != '\0' && manifest.patch_size >= manifest.compressed_size) {
+        ESP_LOGI(TAG, "El parche (%d bytes) no es menor que la imagen comprimida (%d bytes), se descarta.",
+                 manifest.patch_size, manifest.compressed_size);
+        use_patch = false;
+    }
+
+    // Solo vuelve si falla: tras una actualización correcta el equipo se reinicia
+    if (use_patch) {
+        err = perform_ota_delta_update(&manifest);
+        if (!ota_worker_format_error(err)) {
+            ota_unresumable_failed(&manifest);
+            return err;
+        }
+        ESP_LOGW(TAG, "La actualización delta no se pudo aplicar, se descarga la imagen completa.");
+    }
+    if (!full_only && manifest.compressed_url[0] != '\0') {
+        err = perform_ota_compressed_update(&manifest);
+        if (!ota_worker_format_error(err)) {
+            ota_unresumable_failed(&manifest);
+            return err;
+        }
+        ESP_LOGW(TAG, "La imagen comprimida no se pudo instalar, se descarga sin comprimir.");
+    }
+    return perform_ota_update(manifest.url[0] != '\0' ? manifest.url : worker_firmware_url, &manifest);
+}
+
+static void ota_worker_task(void *arg) {
+    unsigned failures = 0;
+    for (;;) {
+        // Tras varios errores seguidos se espera cada vez más. El jitter evita
+        // que todos los equipos consulten el servidor al mismo tiempo.
+        uint32_t wait_ms = failures == 0
+            ? power_jitter_ms(worker_interval_ms)
+            : power_backoff_ms(worker_interval_ms, CONFIG_OTA_CHECK_MAX_BACKOFF_MS, failures);
+
+        // pdTRUE descarta las notificaciones acumuladas: varias peticiones = una verificación
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+        if (!power_is_connected()) {
+            // Al reconectar, main.c pide una verificación
+            continue;
+        }
+
+        worker_state = OTA_WORKER_CHECKING;
+        power_busy_begin();
+        esp_err_t err = ota_worker_check();
+        power_busy_end();
+        worker_state = OTA_WORKER_IDLE;
+
+        if (err == ESP_OK) {
+            failures = 0;
+        } else if (failures < 16) {
+            failures++;
+        }
+    }
+}
+
+esp_err_t ota_worker_start(const char *manifest_url, const char *firmware_url, uint32_t interval_ms) {
+    if (worker_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    worker_manifest_url = manifest_url;
+    worker_firmware_url = firmware_url;
+    worker_interval_ms = interval_ms;
+    if (xTaskCreatePinnedToCore(ota_worker_task, "ota_worker", CONFIG_OTA_WORKER_TASK_STACK_SIZE, NULL,
+                                CONFIG_OTA_WORKER_TASK_PRIORITY, &worker_task, OTA_WORKER_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Error creando la tarea de actualizaciones.");
+        worker_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ota_worker_trigger(void) {
+    if (worker_task != NULL) {
+        xTaskNotifyGive(worker_task);
+    }
+}
+
+ota_worker_state_t ota_worker_get_state(void) {
+    return worker_state;
+}
+
+const char *ota_worker_state_name(ota_worker_state_t state) {
+    switch (state) {
+        case OTA_WORKER_CHECKING:
+            return "checking";
+        case OTA_WORKER_UPDATING:
+            return "updating";
+        default:
+            return "idle";
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    OTA_WORKER_IDLE,      // Esperando la siguiente verificación
+    OTA_WORKER_CHECKING,  // Descargando el manifiesto
+    OTA_WORKER_UPDATING,  // Descargando e instalando una imagen
+} ota_worker_state_t;
+
+// Crea la tarea que verifica e instala actualizaciones. Todo el trabajo OTA
+// (manifiesto, descarga y escritura en flash) se hace en esta tarea. Verifica
+// cada `interval_ms` (±10%) mientras hay conexión; tras errores seguidos la
+// espera crece hasta CONFIG_OTA_CHECK_MAX_BACKOFF_MS.
+esp_err_t ota_worker_start(const char *manifest_url, const char *firmware_url, uint32_t interval_ms);
+
+// Pide una verificación inmediata. Se puede llamar desde cualquier tarea; si
+// ya hay una verificación en curso las peticiones se agrupan en una sola que
+// se ejecuta al terminar.
+void ota_worker_trigger(void);
+
+ota_worker_state_t ota_worker_get_state(void);
+
+const char *ota_worker_state_name(ota_worker_state_t state);
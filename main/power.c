@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "power.h"
+
+#if CONFIG_POWER_WIFI_PS_MAX_MODEM
+#define POWER_WIFI_PS WIFI_PS_MAX_MODEM
+#else
+#define POWER_WIFI_PS WIFI_PS_MIN_MODEM
+#endif
+
+static const char *TAG = "Power";
+
+static SemaphoreHandle_t power_lock = NULL;
+static volatile bool connected = false;
+static unsigned busy_count;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;
+#endif
+
+// Contabilidad de estados, protegida por power_lock
+static power_state_t current_state = POWER_STATE_OFFLINE;
+static int64_t state_since_us;
+static int64_t state_time_us[POWER_STATE_MAX];
+
+static void power_update_state(void) {
+    int64_t now = esp_timer_get_time();
+    state_time_us[current_state] += now - state_since_us;
+    state_since_us = now;
+    current_state = busy_count > 0 ? POWER_STATE_BUSY : connected ? POWER_STATE_IDLE : POWER_STATE_OFFLINE;
+}
+
+esp_err_t power_init(void) {
+    if (power_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    power_lock = xSemaphoreCreateMutex();
+    if (power_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    state_since_us = esp_timer_get_time();
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_MIN_CPU_FREQ_MHZ,
+#if CONFIG_POWER_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ota", &cpu_lock);
+    }
+    if (err != ESP_OK) {
+        // El equipo funciona igual, solo que sin ahorro de energía
+        ESP_LOGW(TAG, "Error configurando la gestión de energía: %s", esp_err_to_name(err));
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "CPU entre %d y %d MHz, light sleep %s", CONFIG_POWER_MIN_CPU_FREQ_MHZ,
+             CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, pm_config.light_sleep_enable ? "activado" : "desactivado");
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE desactivado: sin escalado de frecuencia ni light sleep.");
+#endif
+    return ESP_OK;
+}
+
+void power_set_connected(bool is_connected) {
+    xSemaphoreTake(power_lock, portMAX_DELAY);
+    connected = is_connected;
+    if (is_connected && busy_count == 0) {
+        esp_wifi_set_ps(POWER_WIFI_PS);
+    }
+    power_update_state();
+    xSemaphoreGive(power_lock);
+}
+
+bool power_is_connected(void) {
+    return connected;
+}
+
+void power_busy_begin(void) {
+    xSemaphoreTake(power_lock, portMAX_DELAY);
+    if (busy_count++ == 0) {
+#if CONFIG_PM_ENABLE
+        if (cpu_lock != NULL) {
+            esp_pm_lock_acquire(cpu_lock);
+        }
+#endif
+        // Con modem sleep la radio solo escucha en cada beacon y la descarga es mucho más lenta
+        esp_wifi_set_ps(WIFI_PS_NONE);
+        power_update_state();
+    }
+    xSemaphoreGive(power_lock);
+}
+
+void power_busy_end(void) {
+    xSemaphoreTake(power_lock, portMAX_DELAY);
+    if (busy_count > 0 && --busy_count == 0) {
+        esp_wifi_set_ps(POWER_WIFI_PS);
+#if CONFIG_PM_ENABLE
+        if (cpu_lock != NULL) {
+            esp_pm_lock_release(cpu_lock);
+        }
+#endif
+        power_update_state();
+    }
+    xSemaphoreGive(power_lock);
+}
+
+uint32_t power_backoff_ms(uint32_t base_ms, uint32_t max_ms, unsigned attempt) {
+    uint64_t delay = (uint64_t)base_ms << (attempt < 16 ? attempt : 16);
+    if (delay > max_ms) {
+        delay = max_ms;
+    }
+    uint32_t half = (uint32_t)delay / 2;
+    return half + esp_random() % (half + 1);
+}
+
+uint32_t power_jitter_ms(uint32_t interval_ms) {
+    uint32_t spread = interval_ms / 10;
+    return interval_ms - spread + esp_random() % (2 * spread + 1);
+}
+
+void power_get_stats(power_stats_t *stats) {
+    xSemaphoreTake(power_lock, portMAX_DELAY);
+    power_update_state();
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        stats->time_ms[i] = (uint64_t)state_time_us[i] / 1000;
+    }
+    xSemaphoreGive(power_lock);
+}
+
+void power_log_pm_profile(void) {
+#if CONFIG_PM_ENABLE && CONFIG_PM_PROFILING
+    esp_pm_dump_locks(stdout);
+#endif
+}
+
+const char *power_state_name(power_state_t state) {
+    switch (state) {
+        case POWER_STATE_IDLE:
+            return "idle";
+        case POWER_STATE_BUSY:
+            return "busy";
+        default:
+            return "offline";
+    }
+}
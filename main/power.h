@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Gestión de energía: frecuencia dinámica y light sleep con esp_pm, modem
+// sleep del Wi-Fi fuera de las descargas, esperas con backoff y jitter, y
+// tiempo acumulado en cada estado de actividad de la aplicación.
+
+typedef enum {
+    POWER_STATE_OFFLINE,  // Sin conexión Wi-Fi, esperando para reconectar
+    POWER_STATE_IDLE,     // Conectado con modem sleep; la CPU puede dormir
+    POWER_STATE_BUSY,     // Verificación o descarga OTA: CPU al máximo y radio despierta
+    POWER_STATE_MAX,
+} power_state_t;
+
+// Tiempo que la aplicación ha pasado en cada estado desde el arranque. No es
+// tiempo de light sleep ni a una frecuencia concreta: en IDLE la CPU duerme
+// solo cuando no hay tareas listas. Para eso está power_log_pm_profile.
+typedef struct {
+    uint64_t time_ms[POWER_STATE_MAX];
+} power_stats_t;
+
+// Configura esp_pm. Debe llamarse antes de iniciar el Wi-Fi.
+esp_err_t power_init(void);
+
+// Informa del estado de la conexión; al conectar activa el modem sleep
+void power_set_connected(bool connected);
+bool power_is_connected(void);
+
+// Marca un trabajo que necesita la CPU y la radio a pleno rendimiento. Las
+// llamadas se pueden anidar; el ahorro se restablece con el último end.
+void power_busy_begin(void);
+void power_busy_end(void);
+
+// Espera antes del intento `attempt` (0 el primero): base_ms * 2^attempt,
+// limitada a max_ms. La mitad del valor es aleatoria para que muchos equipos
+// no reintenten a la vez (por ejemplo, tras reiniciarse el punto de acceso).
+uint32_t power_backoff_ms(uint32_t base_ms, uint32_t max_ms, unsigned attempt);
+
+// `interval_ms` con una variación aleatoria del ±10%
+uint32_t power_jitter_ms(uint32_t interval_ms);
+
+void power_get_stats(power_stats_t *stats);
+
+// Con CONFIG_PM_PROFILING, escribe en la consola el tiempo real que esp_pm ha
+// pasado en cada modo (frecuencia máxima, mínima, light sleep) y los locks
+// activos. Sin esa opción no hace nada.
+void power_log_pm_profile(void);
+
+const char *power_state_name(power_state_t state);
@@ -0,0 +1,199 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_netif_sntp.h"
+#include "cJSON.h"
+#include "http_conn.h"
+#include "ota_worker.h"
+#include "power.h"
+#include "telemetry.h"
+
+#define TELEMETRY_BUFFER_SIZE CONFIG_TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_VALID_EPOCH 1600000000 // Antes de esta fecha el reloj no está sincronizado
+
+static const char *TAG = "Telemetry";
+
+// Una muestra del estado del equipo
+typedef struct {
+    int64_t uptime_us;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    int8_t rssi;            // 0 si no hay conexión
+    ota_worker_state_t ota_state;
+} telemetry_sample_t;
+
+// Búfer circular de muestras pendientes de enviar; si se llena se descartan las más antiguas
+static telemetry_sample_t samples[TELEMETRY_BUFFER_SIZE];
+static size_t sample_head;   // Posición de la muestra más antigua
+static size_t sample_count;
+static uint32_t samples_dropped;
+
+static const char *telemetry_url = NULL;
+
+static void telemetry_sample(void) {
+    telemetry_sample_t *sample;
+    if (sample_count == TELEMETRY_BUFFER_SIZE) {
+        sample = &samples[sample_head];
+        sample_head = (sample_head + 1) % TELEMETRY_BUFFER_SIZE;
+        samples_dropped++;
+    } else {
+        sample = &samples[(sample_head + sample_count) % TELEMETRY_BUFFER_SIZE];
+        sample_count++;
+    }
+
+    wifi_ap_record_t ap;
+    sample->uptime_us = esp_timer_get_time();
+    sample->free_heap = esp_get_free_heap_size();
+    sample->min_free_heap = esp_get_minimum_free_heap_size();
+    sample->rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+    sample->ota_state = ota_worker_get_state();
+}
+
+// Convierte las muestras en [{"ts": ms, "values": {...}}, ...]. Si el reloj
+// aún no está sincronizado se omite "ts" y el servidor usa la hora de llegada.
+static char *telemetry_serialize(size_t count) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t now_us = esp_timer_get_time();
+    bool synced = now.tv_sec >= TELEMETRY_VALID_EPOCH;
+    int64_t now_ms = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+
+    cJSON *batch = cJSON_CreateArray();
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_sample_t *sample = &samples[(sample_head + i) % TELEMETRY_BUFFER_SIZE];
+        cJSON *entry = cJSON_CreateObject();
+        if (synced) {
+            cJSON_AddNumberToObject(entry, "ts", (double)(now_ms - (now_us - sample->uptime_us) / 1000));
+        }
+        cJSON *values = cJSON_AddObjectToObject(entry, "values");
+        cJSON_AddNumberToObject(values, "uptime_s", (double)(sample->uptime_us / 1000000));
+        cJSON_AddNumberToObject(values, "heap_free", sample->free_heap);
+        cJSON_AddNumberToObject(values, "heap_min_free", sample->min_free_heap);
+        if (sample->rssi != 0) {
+            cJSON_AddNumberToObject(values, "rssi", sample->rssi);
+        }
+        cJSON_AddStringToObject(values, "ota_state", ota_worker_state_name(sample->ota_state));
+        if (i == count - 1) {
+            http_conn_stats_t http;
+            http_conn_get_stats(&http);
+            cJSON_AddNumberToObject(values, "samples_dropped", samples_dropped);
+            cJSON_AddNumberToObject(values, "http_requests", http.requests);
+            cJSON_AddNumberToObject(values, "http_connects", http.connects);
+            cJSON_AddNumberToObject(values, "http_reused", http.reused);
+            cJSON_AddNumberToObject(values, "http_connect_ms", http.last_connect_ms);
+
+            power_stats_t power;
+            power_get_stats(&power);
+            for (int state = 0; state < POWER_STATE_MAX; state++) {
+                char key[24];
+                snprintf(key, sizeof(key), "activity_%s_s", power_state_name(state));
+                cJSON_AddNumberToObject(values, key, (double)(power.time_ms[state] / 1000));
+            }
+        }
+        cJSON_AddItemToArray(batch, entry);
+    }
+
+    char *json = cJSON_PrintUnformatted(batch);
+    cJSON_Delete(batch);
+    return json;
+}
+
+// Envía todas las muestras pendientes en un único POST. Si falla se conservan
+// para el siguiente intento y se devuelve false. Sin muestras o sin WiFi no hay
+// nada que reintentar y se devuelve true.
+static bool telemetry_flush(void) {
+    wifi_ap_record_t ap;
+    if (sample_count == 0 || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return true;
+    }
+
+    size_t count = sample_count;
+    char *json = telemetry_serialize(count);
+    if (json == NULL) {
+        ESP_LOGE(TAG, "Error: No se pudo asignar memoria para el lote.");
+        return false;
+    }
+
+    http_conn_t *conn = http_conn_acquire(telemetry_url, HTTP_METHOD_POST, NULL, NULL);
+    if (conn == NULL) {
+        free(json);
+        return false;
+    }
+    esp_http_client_handle_t client = http_conn_client(conn);
+    http_conn_set_header(conn, "Content-Type", "application/json");
+    esp_http_client_set_post_field(client, json, strlen(json));
+    esp_err_t err = http_conn_perform(conn);
+    int status = esp_http_client_get_status_code(client);
+    bool sent = err == ESP_OK && status >= 200 && status < 300;
+    if (sent) {
+        ESP_LOGI(TAG, "%u muestras enviadas (%u bytes)", (unsigned)count, (unsigned)strlen(json));
+        sample_head = (sample_head + count) % TELEMETRY_BUFFER_SIZE;
+        sample_count -= count;
+        samples_dropped = 0;
+    } else {
+        ESP_LOGW(TAG, "Error enviando telemetría: %s (HTTP %d)", esp_err_to_name(err), status);
+    }
+    // Si falla se fuerza una conexión nueva en el próximo envío
+    http_conn_release(conn, err == ESP_OK);
+    free(json);
+    return sent;
+}
+
+static void telemetry_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t next_flush = esp_timer_get_time() + (int64_t)CONFIG_TELEMETRY_FLUSH_INTERVAL_MS * 1000;
+    unsigned failures = 0;
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_TELEMETRY_SAMPLE_INTERVAL_MS));
+        telemetry_sample();
+
+        // Tras un envío fallido el lote sigue lleno: no se reintenta hasta
+        // next_flush, que se aleja con cada fallo seguido
+        int64_t now = esp_timer_get_time();
+        if (now >= next_flush || (failures == 0 && sample_count >= CONFIG_TELEMETRY_BATCH_SIZE)) {
+            uint32_t wait_ms = CONFIG_TELEMETRY_FLUSH_INTERVAL_MS;
+            if (telemetry_flush()) {
+                failures = 0;
+            } else {
+                if (failures < 16) {
+                    failures++;
+                }
+                wait_ms = power_backoff_ms(CONFIG_TELEMETRY_SAMPLE_INTERVAL_MS, CONFIG_TELEMETRY_FLUSH_INTERVAL_MS,
+                                           failures);
+            }
+            next_flush = now + (int64_t)wait_ms * 1000;
+            power_log_pm_profile();
+        }
+    }
+}
+
+esp_err_t telemetry_start(const char *url) {
+    if (telemetry_url != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    telemetry_url = url;
+
+    // Hora real para las marcas de tiempo de las muestras
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_TELEMETRY_SNTP_SERVER);
+    esp_err_t err = esp_netif_sntp_init(&sntp_config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error iniciando SNTP: %s", esp_err_to_name(err));
+    }
+
+    if (xTaskCreate(telemetry_task, "telemetry", CONFIG_TELEMETRY_TASK_STACK_SIZE, NULL,
+                    CONFIG_TELEMETRY_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Error creando la tarea de telemetría.");
+        telemetry_url = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "esp_err.h"
+
+// Toma muestras del estado del equipo (heap, RSSI, tiempo encendido, estado
+// OTA) cada CONFIG_TELEMETRY_SAMPLE_INTERVAL_MS en un búfer circular y las
+// envía agrupadas a `url` (API de telemetría de ThingsBoard) en un único POST
+// con un array JSON. Se envía al reunir CONFIG_TELEMETRY_BATCH_SIZE muestras o
+// cada CONFIG_TELEMETRY_FLUSH_INTERVAL_MS, reutilizando la misma conexión.
+esp_err_t telemetry_start(const char *url);
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Banco de pruebas de las actualizaciones OTA en QEMU.
+
+Para cada escenario arranca el servidor de tools/ota_bench_server.py con su
+perfil de red y lanza en qemu-system-xtensa el firmware compilado con
+sdkconfig.bench. Después recoge las líneas OTA_METRICS que registra cada
+descarga y muestra un resumen:
+
+    idf.py -B build-bench -D SDKCONFIG=build-bench/sdkconfig \\
+        -D SDKCONFIG_DEFAULTS="sdkconfig;sdkconfig.bench" build
+    python tools/ota_bench.py --build-dir build-bench --runs 3
+
+Sale con código 1 si algún escenario no termina como se espera (por ejemplo,
+si una imagen truncada llega a instalarse).
+"""
+import argparse
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+import ota_bench_server
+
+# Opciones del servidor por escenario y resultado esperado de cada descarga
+SCENARIOS = {
+    'lan': ({}, 'ok'),
+    'compressed': ({'format': 'compressed'}, 'ok'),
+    'slow': ({'bandwidth': 64, 'latency': 150}, 'ok'),
+    'lossy': ({'drop': 0.5, 'latency': 50}, 'ok'),
+    # La imagen comprimida no se puede continuar: tras varios cortes se pasa a la completa
+    'compressed-lossy': ({'format': 'compressed', 'drop': 0.5, 'latency': 50}, 'ok'),
+    'truncated': ({'truncate': 1.0}, 'fail'),
+}
+
+COLUMNS = ('format', 'result', 'bytes', 'connect_ms', 'reused', 'first_byte_ms', 'erase_ms', 'write_ms',
+           'verify_ms', 'total_ms', 'heap_peak')
+METRICS_RE = re.compile(r'OTA_METRICS ((?:\w+=\S+ ?)+)')
+ANSI_RE = re.compile(r'\x1b\[[0-9;]*m')
+
+
+def check_build(build_dir):
+    """Comprueba que build_dir es una compilación con sdkconfig.bench."""
+    path = os.path.join(build_dir, 'config', 'sdkconfig.json')
+    try:
+        with open(path) as f:
+            config = json.load(f)
+    except OSError:
+        sys.exit('error: no se encuentra %s; compila primero el firmware del banco de pruebas' % path)
+    if not config.get('OTA_BENCH_ENABLE'):
+        sys.exit('error: %s no se compiló con sdkconfig.bench (CONFIG_OTA_BENCH_ENABLE desactivado)' % build_dir)
+
+
+def flash_image(build_dir):
+    """Une bootloader, tabla de particiones y aplicación en una imagen de 2 MB."""
+    subprocess.check_call([sys.executable, '-m', 'esptool', '--chip', 'esp32', 'merge_bin',
+                           '--fill-flash-size', '2MB', '-o', 'qemu_flash.bin', '@flash_args'],
+                          cwd=build_dir, stdout=subprocess.DEVNULL)
+    return os.path.join(build_dir, 'qemu_flash.bin')
+
+
+def start_qemu(qemu, image):
+    # -nic user: el equipo ve al PC en 10.0.2.2 a través de la Ethernet OpenCores
+    return subprocess.Popen([qemu, '-nographic', '-machine', 'esp32',
+                             '-drive', 'file=%s,if=mtd,format=raw' % image,
+                             '-nic', 'user,model=open_eth'],
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            text=True, errors='replace')
+
+
+def read_lines(stream, lines):
+    for line in stream:
+        lines.put(line)
+    lines.put(None)
+
+
+def parse_metrics(line):
+    match = METRICS_RE.search(ANSI_RE.sub('', line))
+    if match is None:
+        return None
+    metrics = dict(item.split('=', 1) for item in match.group(1).split())
+    for key, value in metrics.items():
+        if value.isdigit():
+            metrics[key] = int(value)
+    return metrics
+
+
+def run_scenario(name, args, image):
+    overrides, expect = SCENARIOS[name]
+    server_args = argparse.Namespace(**vars(args))
+    server_args.force_update = True
+    # Se sirve la imagen que corre en QEMU, salvo que se indique otro directorio
+    if server_args.root is None:
+        server_args.root = args.build_dir
+    if server_args.format == 'auto':
+        server_args.format = 'raw'
+    for key, value in overrides.items():
+        setattr(server_args, key, value)
+
+    config = ota_bench_server.config_from_args(server_args)
+    server = ota_bench_server.make_server(config, args.port, args.certfile, args.keyfile)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    qemu = start_qemu(args.qemu, image)
+    lines = queue.Queue()
+    threading.Thread(target=read_lines, args=(qemu.stdout, lines), daemon=True).start()
+
+    results = []
+    deadline = time.monotonic() + args.timeout
+    try:
+        while time.monotonic() < deadline:
+            try:
+                line = lines.get(timeout=1)
+            except queue.Empty:
+                continue
+            if line is None:
+                break
+            if args.verbose:
+                sys.stdout.write('    | ' + line)
+            metrics = parse_metrics(line)
+            if metrics is None:
+                continue
+            metrics['scenario'] = name
+            results.append(metrics)
+            successes = sum(m['result'] == 'ESP_OK' for m in results)
+            if expect == 'ok' and successes >= args.runs:
+                break
+            if expect == 'fail' and (successes > 0 or len(results) >= args.runs):
+                break
+    finally:
+        qemu.kill()
+        qemu.wait()
+        server.shutdown()
+        server.server_close()
+
+    successes = sum(m['result'] == 'ESP_OK' for m in results)
+    passed = successes >= args.runs if expect == 'ok' else successes == 0 and len(results) >= args.runs
+    return results, passed
+
+
+def print_results(name, results, passed):
+    print('%s: %s' % (name, 'OK' if passed else 'FALLO'))
+    print('    ' + ' '.join('%13s' % column for column in COLUMNS + ('KB/s',)))
+    for metrics in results:
+        total = metrics.get('total_ms', 0)
+        rate = metrics.get('bytes', 0) * 1000 / 1024 / total if total else 0
+        print('    ' + ' '.join('%13s' % metrics.get(column, '-') for column in COLUMNS) + ' %13.0f' % rate)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ota_bench_server.add_arguments(parser)
+    parser.add_argument('--build-dir', default='build-bench',
+                        help='compilación con sdkconfig.bench (por defecto build-bench)')
+    parser.add_argument('--qemu', default='qemu-system-xtensa', help='ejecutable de QEMU para ESP32')
+    parser.add_argument('--scenario', action='append', choices=sorted(SCENARIOS),
+                        help='escenario a ejecutar; se puede repetir (por defecto todos)')
+    parser.add_argument('--runs', type=int, default=1, help='descargas por escenario')
+    parser.add_argument('--timeout', type=float, default=600, help='segundos máximos por escenario')
+    parser.add_argument('--json', help='guarda todas las métricas en este fichero')
+    parser.add_argument('-v', '--verbose', action='store_true', help='muestra la salida del equipo')
+    args = parser.parse_args()
+    check_build(args.build_dir)
+
+    all_results = []
+    all_passed = True
+    for name in args.scenario or list(SCENARIOS):
+        # Imagen nueva en cada escenario: sin descargas a medias ni ETag guardado
+        image = flash_image(args.build_dir)
+        print('Escenario %s...' % name, flush=True)
+        results, passed = run_scenario(name, args, image)
+        print_results(name, results, passed)
+        all_results += results
+        all_passed = all_passed and passed
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            f.write(json.dumps(all_results, indent=2) + '\n')
+    sys.exit(0 if all_passed else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Servidor local de firmware para medir y probar las actualizaciones OTA.
+
+Sirve los ficheros de un directorio (por defecto build/) por HTTP/1.1 con
+keep-alive, Range y ETag, igual que raw.githubusercontent.com, y simula una
+red peor:
+
+    --bandwidth KB/s   limita la velocidad de cada respuesta
+    --latency MS       retrasa cada respuesta
+    --drop P           corta la conexión a mitad de la imagen con probabilidad P
+    --truncate P       sirve la imagen incompleta, con un Content-Length que
+                       coincide, con probabilidad P
+
+Con --force-update el manifiesto anuncia un elf_sha256 que no es el del
+firmware, así que el equipo descarga la imagen en cada verificación aunque ya
+la tenga instalada. --format elige qué imagen anuncia el manifiesto.
+Con --certfile y --keyfile sirve HTTPS.
+"""
+import argparse
+import hashlib
+import json
+import os
+import random
+import re
+import socket
+import ssl
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlsplit
+
+CHUNK_SIZE = 4096
+
+
+class BenchConfig:
+    def __init__(self, root, bandwidth=0, latency=0, drop=0.0, truncate=0.0,
+                 force_update=False, image_format='auto', seed=None):
+        self.root = root
+        self.bandwidth = bandwidth * 1024   # bytes/s; 0 sin límite
+        self.latency = latency / 1000.0
+        self.drop = drop
+        self.truncate = truncate
+        self.force_update = force_update
+        self.image_format = image_format
+        self.rng = random.Random(seed)
+        self.lock = threading.Lock()
+        self.events = []                    # (ruta, estado, bytes enviados, segundos, fallo)
+
+    def roll(self, probability):
+        with self.lock:
+            return self.rng.random() < probability
+
+    def randint(self, low, high):
+        with self.lock:
+            return self.rng.randint(low, high)
+
+    def record(self, *event):
+        with self.lock:
+            self.events.append(event)
+
+    def manifest(self, data):
+        manifest = json.loads(data)
+        if self.force_update:
+            manifest['elf_sha256'] = '0' * 64
+        if self.image_format != 'auto':
+            manifest.pop('patches', None)
+        if self.image_format == 'raw':
+            manifest.pop('compressed', None)
+        return (json.dumps(manifest, indent=2) + '\n').encode()
+
+
+class BenchHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    config = None  # BenchConfig; se asigna en make_server
+
+    def setup(self):
+        super().setup()
+        self.requests_on_connection = 0
+
+    def do_GET(self):
+        self.requests_on_connection += 1
+        config = self.config
+        time.sleep(config.latency)
+
+        name = os.path.basename(urlsplit(self.path).path)
+        path = os.path.join(config.root, name)
+        if not name or not os.path.isfile(path):
+            self.send_empty(404)
+            return
+        with open(path, 'rb') as f:
+            data = f.read()
+
+        is_manifest = name.endswith('.json')
+        if is_manifest:
+            data = config.manifest(data)
+        etag = '"%s"' % hashlib.sha256(data).hexdigest()[:16]
+        if self.headers.get('If-None-Match') == etag:
+            self.send_empty(304, etag)
+            return
+
+        fault = None
+        if not is_manifest and config.roll(config.truncate):
+            data = data[:config.randint(len(data) // 2, len(data) - 1)]
+            fault = 'truncate'
+
+        status, start = 200, 0
+        match = re.fullmatch(r'bytes=(\d+)-', self.headers.get('Range', ''))
+        if match and int(match.group(1)) < len(data):
+            status, start = 206, int(match.group(1))
+        body = data[start:]
+
+        drop_at = None
+        if not is_manifest and body and config.roll(config.drop):
+            drop_at = config.randint(0, len(body) - 1)
+            fault = 'drop'
+
+        self.send_response(status)
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('ETag', etag)
+        self.send_header('Accept-Ranges', 'bytes')
+        if status == 206:
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, len(data) - 1, len(data)))
+        self.end_headers()
+
+        started = time.monotonic()
+        sent = self.send_body(body, drop_at)
+        elapsed = time.monotonic() - started
+        config.record(name, status, sent, elapsed, fault)
+        print('%s %s %d: %d/%d bytes en %.2f s (%.0f KB/s), petición %d en esta conexión%s' % (
+            time.strftime('%H:%M:%S'), name, status, sent, len(body), elapsed,
+            sent / 1024 / elapsed if elapsed > 0 else 0, self.requests_on_connection,
+            ', ' + fault if fault else ''), flush=True)
+
+    def send_body(self, body, drop_at):
+        started = time.monotonic()
+        sent = 0
+        while sent < len(body):
+            end = min(sent + CHUNK_SIZE, len(body))
+            if drop_at is not None and end > drop_at:
+                self.wfile.write(body[sent:drop_at])
+                self.wfile.flush()
+                # SO_LINGER a 0: el cierre envía un RST, como una caída de la red
+                self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack('ii', 1, 0))
+                self.close_connection = True
+                return drop_at
+            self.wfile.write(body[sent:end])
+            sent = end
+            if self.config.bandwidth:
+                delay = started + sent / self.config.bandwidth - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+        return sent
+
+    def send_empty(self, status, etag=None):
+        self.send_response(status)
+        if etag:
+            self.send_header('ETag', etag)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def make_server(config, port, certfile=None, keyfile=None):
+    handler = type('Handler', (BenchHandler,), {'config': config})
+    server = ThreadingHTTPServer(('', port), handler)
+    server.daemon_threads = True
+    if certfile:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(certfile, keyfile)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    return server
+
+
+DEFAULT_ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'build'))
+
+
+def add_arguments(parser):
+    parser.add_argument('--root',
+                        help='directorio con app-template.bin y el manifiesto (por defecto build/)')
+    parser.add_argument('--port', type=int, default=8070)
+    parser.add_argument('--certfile', help='certificado para servir HTTPS')
+    parser.add_argument('--keyfile', help='clave privada del certificado')
+    parser.add_argument('--bandwidth', type=float, default=0, help='KB/s por respuesta; 0 sin límite')
+    parser.add_argument('--latency', type=float, default=0, help='retraso de cada respuesta en ms')
+    parser.add_argument('--drop', type=float, default=0, help='probabilidad de cortar una descarga')
+    parser.add_argument('--truncate', type=float, default=0,
+                        help='probabilidad de servir la imagen incompleta')
+    parser.add_argument('--force-update', action='store_true',
+                        help='anuncia siempre una versión distinta de la instalada')
+    parser.add_argument('--format', choices=('auto', 'raw', 'compressed'), default='auto',
+                        help='imagen que anuncia el manifiesto (auto: la del manifiesto)')
+    parser.add_argument('--seed', type=int, help='semilla de los fallos, para repetir una prueba')
+
+
+def config_from_args(args):
+    return BenchConfig(args.root or DEFAULT_ROOT, bandwidth=args.bandwidth, latency=args.latency, drop=args.drop,
+                       truncate=args.truncate, force_update=args.force_update,
+                       image_format=args.format, seed=args.seed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    add_arguments(parser)
+    args = parser.parse_args()
+    server = make_server(config_from_args(args), args.port, args.certfile, args.keyfile)
+    print('Sirviendo %s en el puerto %d (%s)' % (args.root or DEFAULT_ROOT, args.port, 'https' if args.certfile else 'http'))
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Genera un parche OTA delta entre la imagen en ejecución y la nueva.
+
+Formato (little-endian), aplicado en streaming por main/ota_delta.c:
+
+    cabecera: "OTAD", base_size u32, target_size u32,
+              base_sha256[32], target_sha256[32]
+    operaciones hasta completar target_size:
+        0x01 COPY   base_offset u32, length u32  -> copia desde la partición en ejecución
+        0x02 INSERT length u32, datos[length]    -> datos nuevos incluidos en el parche
+
+Con --manifest se añade el parche a la lista "patches" del manifiesto de la
+imagen nueva, asociado al elf_sha256 de la imagen base. El manifiesto debe
+ser el de la imagen nueva (se comprueban size, sha256 y elf_sha256) y guarda
+como mucho --max-patches parches.
+"""
+import argparse
+import hashlib
+import json
+import os
+import struct
+import sys
+
+from ota_manifest import read_app_desc
+
+MAGIC = b'OTAD'
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+WINDOW = 32      # Bytes que deben coincidir para buscar una copia
+INDEX_STEP = 8   # Se indexa una ventana de la base cada INDEX_STEP bytes
+MIN_COPY = 48    # Una copia más corta cuesta más que insertar los datos
+MAX_CANDIDATES = 8
+
+
+def build_index(base):
+    index = {}
+    for pos in range(0, len(base) - WINDOW + 1, INDEX_STEP):
+        candidates = index.setdefault(base[pos:pos + WINDOW], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+    return index
+
+
+def match_length(base, b, target, t, limit):
+    n = 0
+    while n < limit and b + n < len(base) and t + n < len(target) and base[b + n] == target[t + n]:
+        n += 1
+    return n
+
+
+def diff(base, target):
+    """Devuelve la lista de operaciones (OP_COPY, offset, len) / (OP_INSERT, datos)."""
+    index = build_index(base)
+    ops = []
+    literal_start = 0
+    t = 0
+    while t + WINDOW <= len(target):
+        best_len, best_base, best_back = 0, 0, 0
+        for b in index.get(target[t:t + WINDOW], ()):
+            # Extiende la coincidencia hacia atrás sobre los datos pendientes de insertar
+            back = 0
+            while back < t - literal_start and back < b and base[b - back - 1] == target[t - back - 1]:
+                back += 1
+            length = back + match_length(base, b, target, t, len(target))
+            if length > best_len:
+                best_len, best_base, best_back = length, b - back, back
+        if best_len < MIN_COPY:
+            t += 1
+            continue
+
+        start = t - best_back
+        if start > literal_start:
+            ops.append((OP_INSERT, target[literal_start:start]))
+        ops.append((OP_COPY, best_base, best_len))
+        t = start + best_len
+        literal_start = t
+
+    if literal_start < len(target):
+        ops.append((OP_INSERT, target[literal_start:]))
+    return ops
+
+
+def encode(base, target, ops):
+    out = bytearray(MAGIC)
+    out += struct.pack('<II', len(base), len(target))
+    out += hashlib.sha256(base).digest()
+    out += hashlib.sha256(target).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack('<BII', OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack('<BI', OP_INSERT, len(op[1]))
+            out += op[1]
+    return bytes(out)
+
+
+def apply(base, patch):
+    """Aplica un parche en memoria; se usa para comprobar el resultado."""
+    if patch[:4] != MAGIC:
+        raise ValueError('no es un parche OTAD')
+    base_size, target_size = struct.unpack_from('<II', patch, 4)
+    if hashlib.sha256(base[:base_size]).digest() != patch[12:44]:
+        raise ValueError('la base no coincide con el parche')
+    out = bytearray()
+    pos = 76
+    while len(out) < target_size:
+        op = patch[pos]
+        if op == OP_COPY:
+            offset, length = struct.unpack_from('<II', patch, pos + 1)
+            out += base[offset:offset + length]
+            pos += 9
+        elif op == OP_INSERT:
+            length, = struct.unpack_from('<I', patch, pos + 1)
+            out += patch[pos + 5:pos + 5 + length]
+            pos += 5 + length
+        else:
+            raise ValueError('operación desconocida 0x%02x' % op)
+    return bytes(out)
+
+
+def add_to_manifest(path, base, target, patch, url, max_patches):
+    with open(path) as f:
+        manifest = json.load(f)
+    # Un parche añadido al manifiesto de otra imagen no llegaría a aplicarse
+    expected = {
+        'size': len(target),
+        'sha256': hashlib.sha256(target).hexdigest(),
+        'elf_sha256': read_app_desc(target)['elf_sha256'],
+    }
+    for key, value in expected.items():
+        if manifest.get(key) != value:
+            sys.exit('error: %s de %s no corresponde a la imagen nueva (%s, esperado %s)' %
+                     (key, path, manifest.get(key), value))
+
+    base_elf_sha256 = read_app_desc(base)['elf_sha256']
+    patches = [p for p in manifest.get('patches', []) if p['base_elf_sha256'] != base_elf_sha256]
+    patches.append({
+        'base_elf_sha256': base_elf_sha256,
+        'url': url,
+        'size': len(patch),
+    })
+    # El equipo lee el manifiesto en un buffer de CONFIG_OTA_MANIFEST_MAX_LEN bytes:
+    # se conservan los parches más recientes
+    dropped = patches[:-max_patches]
+    for p in dropped:
+        print('Se quita del manifiesto el parche desde %s' % p['base_elf_sha256'][:16])
+    manifest['patches'] = patches[-max_patches:]
+    text = json.dumps(manifest, indent=2) + '\n'
+    with open(path, 'w') as f:
+        f.write(text)
+    return len(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('base', help='imagen que ejecutan los dispositivos (.bin)')
+    parser.add_argument('target', help='imagen nueva (.bin)')
+    parser.add_argument('-o', '--output', required=True, help='fichero del parche')
+    parser.add_argument('--manifest', help='manifiesto de la imagen nueva al que añadir el parche')
+    parser.add_argument('--url', help='URL de descarga del parche (obligatoria con --manifest)')
+    parser.add_argument('--max-patches', type=int, default=8,
+                        help='parches que conserva el manifiesto; se quitan los más antiguos (por defecto 8)')
+    args = parser.parse_args()
+    if args.manifest and not args.url:
+        parser.error('--manifest requiere --url')
+    if args.max_patches < 1:
+        parser.error('--max-patches debe ser al menos 1')
+
+    with open(args.base, 'rb') as f:
+        base = f.read()
+    with open(args.target, 'rb') as f:
+        target = f.read()
+
+    patch = encode(base, target, diff(base, target))
+    if apply(base, patch) != target:
+        sys.exit('error: el parche generado no reproduce la imagen nueva')
+
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+    if args.manifest:
+        manifest_len = add_to_manifest(args.manifest, base, target, patch, args.url, args.max_patches)
+        print('%s: %d bytes' % (os.path.basename(args.manifest), manifest_len))
+
+    print('%s: %d bytes (imagen %d bytes, %.1fx menos)' %
+          (os.path.basename(args.output), len(patch), len(target), len(target) / max(len(patch), 1)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Genera el manifiesto OTA (versión, tamaño y SHA-256) de una imagen de aplicación.
+
+El dispositivo descarga este JSON pequeño en cada verificación y solo baja la
+imagen completa cuando el `elf_sha256` difiere del de la aplicación en ejecución.
+"""
+import argparse
+import hashlib
+import json
+import struct
+import sys
+
+# esp_image_header_t (24 bytes) + esp_image_segment_header_t (8 bytes)
+APP_DESC_OFFSET = 0x20
+APP_DESC_MAGIC = 0xABCD5432
+
+
+def read_app_desc(image):
+    magic, = struct.unpack_from('<I', image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        raise ValueError('la imagen no contiene esp_app_desc_t')
+
+    def field(offset, size):
+        raw = image[APP_DESC_OFFSET + offset:APP_DESC_OFFSET + offset + size]
+        return raw.split(b'\0', 1)[0].decode()
+
+    return {
+        'version': field(16, 32),
+        'project_name': field(48, 32),
+        'elf_sha256': image[APP_DESC_OFFSET + 144:APP_DESC_OFFSET + 176].hex(),
+    }
+
+
+def build_manifest(image, url=None):
+    desc = read_app_desc(image)
+    manifest = {
+        'version': desc['version'],
+        'project_name': desc['project_name'],
+        'elf_sha256': desc['elf_sha256'],
+        'size': len(image),
+        'sha256': hashlib.sha256(image).hexdigest(),
+    }
+    if url:
+        manifest['url'] = url
+    return manifest
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('image', help='imagen de la aplicación (.bin)')
+    parser.add_argument('-o', '--output', help='fichero de salida (por defecto stdout)')
+    parser.add_argument('--url', help='URL de descarga de la imagen completa')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        manifest = build_manifest(f.read(), args.url)
+
+    text = json.dumps(manifest, indent=2) + '\n'
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Comprime una imagen de aplicación para descargarla por OTA.
+
+Formato (little-endian), descomprimido en streaming por main/ota_inflate.c:
+
+    cabecera: "OTAZ", version u8 (1), window_bits u8, reservado u16,
+              uncompressed_size u32, sha256[32] de la imagen sin comprimir
+    datos:    flujo deflate sin cabecera zlib
+
+La ventana deflate se limita a 2^window_bits bytes para que el dispositivo
+solo necesite ese búfer de diccionario mientras descomprime.
+
+Con --manifest se añade la entrada "compressed" al manifiesto de la imagen.
+"""
+import argparse
+import hashlib
+import json
+import os
+import struct
+import zlib
+
+MAGIC = b'OTAZ'
+VERSION = 1
+
+
+def pack(image, window_bits):
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -window_bits, 9)
+    data = compressor.compress(image) + compressor.flush()
+    header = MAGIC + struct.pack('<BBHI', VERSION, window_bits, 0, len(image))
+    return header + hashlib.sha256(image).digest() + data
+
+
+def unpack(packed):
+    """Descomprime un fichero OTAZ; se usa para comprobar el resultado."""
+    if packed[:4] != MAGIC:
+        raise ValueError('no es un fichero OTAZ')
+    version, window_bits, _, size = struct.unpack_from('<BBHI', packed, 4)
+    image = zlib.decompress(packed[44:], -window_bits)
+    if len(image) != size or hashlib.sha256(image).digest() != packed[12:44]:
+        raise ValueError('la imagen descomprimida no coincide con la cabecera')
+    return image
+
+
+def add_to_manifest(path, packed, url):
+    with open(path) as f:
+        manifest = json.load(f)
+    manifest['compressed'] = {'url': url, 'size': len(packed)}
+    with open(path, 'w') as f:
+        f.write(json.dumps(manifest, indent=2) + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('image', help='imagen de la aplicación (.bin)')
+    parser.add_argument('-o', '--output', required=True, help='fichero comprimido')
+    parser.add_argument('--window-bits', type=int, default=12, choices=range(9, 16),
+                        help='log2 de la ventana deflate (por defecto 12, 4 KB)')
+    parser.add_argument('--manifest', help='manifiesto al que añadir la imagen comprimida')
+    parser.add_argument('--url', help='URL de descarga; por defecto el nombre del fichero, '
+                        'relativo al manifiesto')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+
+    packed = pack(image, args.window_bits)
+    if unpack(packed) != image:
+        raise SystemExit('error: la imagen comprimida no reproduce la original')
+
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+    if args.manifest:
+        add_to_manifest(args.manifest, packed, args.url or os.path.basename(args.output))
+
+    print('%s: %d bytes (imagen %d bytes, %.0f%%)' %
+          (os.path.basename(args.output), len(packed), len(image), 100.0 * len(packed) / len(image)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Servidor local que sustituye a ThingsBoard para probar la telemetría.
+
+Acepta POST /api/v1/<token>/telemetry con conexiones keep-alive e imprime cada
+lote recibido. Para usarlo, cambia THINGSBOARD_URL en main/main.c a
+http://<ip-del-pc>:<puerto>/api/v1/test/telemetry.
+"""
+import argparse
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class TelemetryHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'  # Mantiene la conexión abierta entre lotes
+
+    def setup(self):
+        super().setup()
+        self.requests_on_connection = 0
+
+    def do_POST(self):
+        self.requests_on_connection += 1
+        body = self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        try:
+            batch = json.loads(body)
+            status = 200
+        except ValueError:
+            batch, status = None, 400
+
+        if isinstance(batch, list):
+            print('%s %s: %d muestras, %d bytes, petición %d en esta conexión' % (
+                time.strftime('%H:%M:%S'), self.client_address[0], len(batch), len(body),
+                self.requests_on_connection))
+            for entry in batch:
+                print('   ', json.dumps(entry))
+        elif batch is not None:
+            print('%s %s: muestra suelta %s' % (time.strftime('%H:%M:%S'), self.client_address[0],
+                                               json.dumps(batch)))
+
+        self.send_response(status)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--port', type=int, default=8080)
+    args = parser.parse_args()
+    server = ThreadingHTTPServer(('', args.port), TelemetryHandler)
+    print('Escuchando en el puerto %d' % args.port)
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()